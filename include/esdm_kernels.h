@@ -34,7 +34,23 @@
 #define ESDM_FUNCTION_VAR "var"
 #define ESDM_FUNCTION_STAT "stat"
 
+#define ESDM_FUNCTION_WSUM "wsum"
+#define ESDM_FUNCTION_WAVG "wavg"
+#define ESDM_FUNCTION_WSTD "wstd"
+#define ESDM_FUNCTION_WVAR "wvar"
+
+#define ESDM_FUNCTION_ROLLING_SUM "rolling_sum"
+#define ESDM_FUNCTION_ROLLING_AVG "rolling_avg"
+#define ESDM_FUNCTION_ROLLING_MIN "rolling_min"
+#define ESDM_FUNCTION_ROLLING_MAX "rolling_max"
+
 #define ESDM_FUNCTION_OUTLIER "outlier"
+#define ESDM_FUNCTION_HISTOGRAM "histogram"
+#define ESDM_FUNCTION_QUANTILE "quantile"
+#define ESDM_FUNCTION_PERCENTILE "percentile"
+#define ESDM_FUNCTION_ARGMAX "argmax"
+#define ESDM_FUNCTION_ARGMIN "argmin"
+#define ESDM_FUNCTION_COUNT_DISTINCT "count_distinct"
 
 #define ESDM_FUNCTION_SUM_SCALAR "sum_scalar"
 #define ESDM_FUNCTION_MUL_SCALAR "mul_scalar"
@@ -66,6 +82,57 @@
 #define ESDM_FUNCTION_RECI "reci"
 #define ESDM_FUNCTION_NOT "not"
 
+#define ESDM_FUNCTION_EXPR "expr"
+
+// Statistics evaluated by ESDM_FUNCTION_STAT, selected by setting the corresponding character of the argument to '1'.
+// The output record holds the selected statistics in this order: the first six are stored as values of the dataset type,
+// the counters follow as int64_t, starting at the first offset aligned to 8 bytes.
+typedef enum {
+	ESDM_STAT_MIN,
+	ESDM_STAT_MAX,
+	ESDM_STAT_AVG,
+	ESDM_STAT_STD,
+	ESDM_STAT_VAR,
+	ESDM_STAT_SUM,
+	ESDM_STAT_COUNT,	// Number of valid elements
+	ESDM_STAT_MISSING,	// Number of elements equal to the fill value
+	ESDM_STAT_OUTLIER,	// Number of elements beyond the threshold given after the separator, e.g. "000000001,>100"
+	ESDM_STAT_N
+} esdm_stat_t;
+
+// Maximum number of bin edges given to ESDM_FUNCTION_HISTOGRAM
+#define ESDM_HISTOGRAM_EDGES_MAX 257
+
+// Maximum number of quantiles evaluated by ESDM_FUNCTION_QUANTILE and default size of the sketch:
+// the rank error is about 1.7 / size, while the memory used is about 3 * size values
+#define ESDM_QUANTILES_MAX 64
+#define ESDM_SKETCH_SIZE_DEFAULT 200
+
+// Exact percentiles are found by reading the data several times: the values falling in the bin of a percentile
+// are collected once they are not more than this number, otherwise the bin is split into a finer histogram
+#define ESDM_PERCENTILE_COLLECT_MAX (1 << 20)
+
+// ESDM_FUNCTION_ARGMAX and ESDM_FUNCTION_ARGMIN write the extreme as a value of the dataset type, followed at this offset
+// by its global coordinates, one int64_t for each dimension (up to ESDM_ARG_DIMS_MAX)
+#define ESDM_ARG_COORDINATES_OFFSET sizeof(int64_t)
+#define ESDM_ARG_DIMS_MAX 64
+
+// ESDM_FUNCTION_COUNT_DISTINCT counts the values of 8 and 16-bit types exactly, while it estimates the number of distinct values
+// of the other types by a sketch (HyperLogLog) of 2^precision registers: the relative error is about 1.04 / sqrt(2^precision).
+// The number is output as int64_t.
+#define ESDM_DISTINCT_PRECISION_MIN 4
+#define ESDM_DISTINCT_PRECISION_MAX 18
+#define ESDM_DISTINCT_PRECISION_DEFAULT 14
+
+// Maximum number of element-wise operations fused into a chain, e.g. "sum_scalar:-273.15|abs|sqr",
+// which may be followed by a reduction, e.g. "log10|avg"
+#define ESDM_CHAIN_MAX 8
+
+// State of a read: the plan compiled from the operation, the accumulators and the partial results being merged,
+// allocated by esdm_stream_prepare (or on the first call of esdm_stream_func) and released by esdm_stream_release
+typedef struct _esdm_stream_context_t esdm_stream_context_t;
+
+// Has to be zero-initialized (e.g. by memset) before the first call, since context is allocated in case it is NULL
 typedef struct _esdm_stream_data_t {
 	char *operation;
 	char *args;
@@ -75,10 +142,27 @@ typedef struct _esdm_stream_data_t {
 	double value2;
 	uint64_t number;
 	void *fill_value;
+	esdm_dataspace_t *space;	// Dataspace being read, used by axis-wise reductions to locate the output cells
+	const double *const *weights;	// Used by weighted reductions: a vector of weights for each dimension of space, indexed by the position in space
+	// (NULL for unit weights); the weight of an element is the product of the weights of its coordinates
+	const double *weight_array;	// Used by weighted reductions in case weights is NULL: weights of all the elements of space, in row-major order
+	char in_place;		// Element-wise results overwrite the fragment buffer given to esdm_stream_func instead of being written into buff
+	void (*deliver)(esdm_dataspace_t * space, void *buff, void *deliver_ptr);	// Called with each fragment transformed in place, so that buff is not needed
+	void *deliver_ptr;
+	esdm_stream_context_t *context;
 } esdm_stream_data_t;
 
+esdm_status esdm_stream_prepare(esdm_stream_data_t * stream_data);
+esdm_status esdm_stream_prepare_concurrent(esdm_stream_data_t * stream_data);
+void esdm_stream_release(esdm_stream_data_t * stream_data);
+
+const char *esdm_kernels_get_isa(void);
+
 int esdm_is_a_reduce_func(const char *operation, const char *args);
 void *esdm_stream_func(esdm_dataspace_t * space, void *buff, void *user_ptr, void *esdm_fill_value);
 void esdm_reduce_func(esdm_dataspace_t * space, void *user_ptr, void *stream_func_out);
+esdm_status esdm_reduce_finalize(esdm_dataspace_t * space, void *user_ptr);
+// Returns 1 in case the dataspace has to be read again, 0 once the result has been written, -1 in case of error
+int esdm_stream_next_pass(esdm_dataspace_t * space, void *user_ptr);
 
 #endif				//__ESDM_READ_STREAM_H
@@ -19,4763 +19,2671 @@
 #include <stdlib.h>
 #include <math.h>
 #include <ctype.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "esdm_kernels_internal.h"
+
+static const struct {
+	const char *name;
+	esdm_opcode_t opcode;
+	double default_scalar;	// Used when the argument is missing
+} esdm_operations[] = {
+	{ESDM_FUNCTION_NOP, ESDM_OP_NOP, 0},
+	{ESDM_FUNCTION_STREAM, ESDM_OP_NOP, 0},
+	{ESDM_FUNCTION_MAX, ESDM_OP_MAX, 0},
+	{ESDM_FUNCTION_MIN, ESDM_OP_MIN, 0},
+	{ESDM_FUNCTION_AVG, ESDM_OP_AVG, 0},
+	{ESDM_FUNCTION_SUM, ESDM_OP_SUM, 0},
+	{ESDM_FUNCTION_STD, ESDM_OP_STD, 0},
+	{ESDM_FUNCTION_VAR, ESDM_OP_VAR, 0},
+	{ESDM_FUNCTION_STAT, ESDM_OP_STAT, 0},
+	{ESDM_FUNCTION_WSUM, ESDM_OP_WSUM, 0},
+	{ESDM_FUNCTION_WAVG, ESDM_OP_WAVG, 0},
+	{ESDM_FUNCTION_WSTD, ESDM_OP_WSTD, 0},
+	{ESDM_FUNCTION_WVAR, ESDM_OP_WVAR, 0},
+	{ESDM_FUNCTION_ROLLING_SUM, ESDM_OP_ROLLING_SUM, 0},
+	{ESDM_FUNCTION_ROLLING_AVG, ESDM_OP_ROLLING_AVG, 0},
+	{ESDM_FUNCTION_ROLLING_MIN, ESDM_OP_ROLLING_MIN, 0},
+	{ESDM_FUNCTION_ROLLING_MAX, ESDM_OP_ROLLING_MAX, 0},
+	{ESDM_FUNCTION_OUTLIER, ESDM_OP_OUTLIER, 0},
+	{ESDM_FUNCTION_HISTOGRAM, ESDM_OP_HISTOGRAM, 0},
+	{ESDM_FUNCTION_QUANTILE, ESDM_OP_QUANTILE, 0},
+	{ESDM_FUNCTION_PERCENTILE, ESDM_OP_PERCENTILE, 0},
+	{ESDM_FUNCTION_ARGMAX, ESDM_OP_ARGMAX, 0},
+	{ESDM_FUNCTION_ARGMIN, ESDM_OP_ARGMIN, 0},
+	{ESDM_FUNCTION_COUNT_DISTINCT, ESDM_OP_COUNT_DISTINCT, 0},
+	{ESDM_FUNCTION_SUM_SCALAR, ESDM_OP_SUM_SCALAR, 0},
+	{ESDM_FUNCTION_MUL_SCALAR, ESDM_OP_MUL_SCALAR, 1},
+	{ESDM_FUNCTION_ABS, ESDM_OP_ABS, 0},
+	{ESDM_FUNCTION_SQR, ESDM_OP_SQR, 0},
+	{ESDM_FUNCTION_SQRT, ESDM_OP_SQRT, 0},
+	{ESDM_FUNCTION_CEIL, ESDM_OP_CEIL, 0},
+	{ESDM_FUNCTION_FLOOR, ESDM_OP_FLOOR, 0},
+	{ESDM_FUNCTION_INT, ESDM_OP_FLOOR, 0},
+	{ESDM_FUNCTION_ROUND, ESDM_OP_ROUND, 0},
+	{ESDM_FUNCTION_NINT, ESDM_OP_ROUND, 0},
+	{ESDM_FUNCTION_POW, ESDM_OP_POW, 1},
+	{ESDM_FUNCTION_EXP, ESDM_OP_EXP, 0},
+	{ESDM_FUNCTION_LOG, ESDM_OP_LOG, 0},
+	{ESDM_FUNCTION_LOG10, ESDM_OP_LOG10, 0},
+	{ESDM_FUNCTION_SIN, ESDM_OP_SIN, 0},
+	{ESDM_FUNCTION_COS, ESDM_OP_COS, 0},
+	{ESDM_FUNCTION_TAN, ESDM_OP_TAN, 0},
+	{ESDM_FUNCTION_ASIN, ESDM_OP_ASIN, 0},
+	{ESDM_FUNCTION_ACOS, ESDM_OP_ACOS, 0},
+	{ESDM_FUNCTION_ATAN, ESDM_OP_ATAN, 0},
+	{ESDM_FUNCTION_SINH, ESDM_OP_SINH, 0},
+	{ESDM_FUNCTION_COSH, ESDM_OP_COSH, 0},
+	{ESDM_FUNCTION_TANH, ESDM_OP_TANH, 0},
+	{ESDM_FUNCTION_RECI, ESDM_OP_RECI, 0},
+	{ESDM_FUNCTION_NOT, ESDM_OP_NOT, 0},
+	{ESDM_FUNCTION_EXPR, ESDM_OP_EXPR, 0},
+	{NULL, ESDM_OP_N, 0}
+};
+
+// Absolute value of unsigned types
+static inline unsigned long long esdm_uabs(unsigned long long x)
+{
+	return x;
+}
 
-#include "esdm_kernels.h"
+#define esdm_abs(x) _Generic((x), float: fabsf, double: fabs, long long: llabs, \
+	unsigned char: esdm_uabs, unsigned short: esdm_uabs, unsigned int: esdm_uabs, unsigned long long: esdm_uabs, default: abs)(x)
 
-#define UNUSED(x) {(void)(x);}
+// Visit the elements of a fragment, setting idx to the position of the current one: ESDM hands over each fragment
+// as a dense buffer in row-major order, so the position is the linear index
+#define ESDM_FOR_EACH_ELEMENT(f, ...) { \
+	int64_t idx, n = (int64_t) (f)->n; \
+	for (idx = 0; idx < n; idx++) { \
+		__VA_ARGS__ \
+	} \
+}
 
-#define ESDM_FUNCTION_OP_N 3
-#define ESDM_FUNCTION_OP_SET '1'
-#define ESDM_FUNCTION_OP_LESS_THAN '<'
-#define ESDM_FUNCTION_OP_MORE_THAN '>'
+#define ESDM_TYPE_SIZE_ITEM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, ...) sizeof(TYPE),
+static const size_t esdm_type_sizes[ESDM_TYPE_N] = { ESDM_FOR_EACH_TYPE(ESDM_TYPE_SIZE_ITEM, ) };
+
+// Stream kernels
+
+#define ESDM_STREAM_EXTREME(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, CMP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE v = 0, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	tmp->number = 0; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv) && (a[idx] == a[idx]) && (!tmp->number || (v CMP a[idx]))) { \
+			v = a[idx]; \
+			tmp->number++; \
+		}) \
+	tmp->value1 = v; \
+}
 
-typedef struct _esdm_stream_data_out_t {
-	double value1;
-	double value2;
-	double value3;
-	uint64_t number;
-} esdm_stream_data_out_t;
+// NaN elements are skipped, as done by the vectorized kernels
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_EXTREME, max, <)
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_EXTREME, min, >)
+
+#define ESDM_STREAM_SUM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	tmp->value1 = 0; \
+	tmp->number = 0; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv)) { \
+			tmp->value1 += a[idx]; \
+			tmp->number++; \
+		}) \
+}
 
-int esdm_is_a_reduce_func(const char *operation, const char *args)
-{
-	if (!operation)
-		return 0;
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_SUM, sum)
+
+#define ESDM_STREAM_MOMENTS(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	tmp->value1 = 0; \
+	tmp->value2 = 0; \
+	tmp->number = 0; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv)) \
+			esdm_moments_add(tmp->number++, &tmp->value1, &tmp->value2, a[idx]);) \
+}
 
-	if (!strcmp(operation, ESDM_FUNCTION_MAX))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_MIN))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_AVG))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_SUM))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_STD))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_VAR))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_OUTLIER))
-		return 1;
-	if (!strcmp(operation, ESDM_FUNCTION_STAT)) {
-		int i, option = 0;
-		for (i = 0; i < ESDM_FUNCTION_OP_N; ++i)
-			if (args && args[0]) {
-				if (args[0] == ESDM_FUNCTION_OP_SET)
-					option++;
-				args++;
-			} else
-				break;
-		return option;
-	}
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_MOMENTS, moments)
+
+#define ESDM_STREAM_STAT(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE v1 = (TYPE) (HIGHEST), v2 = (TYPE) (LOWEST), fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, t = (TYPE) plan->SCALAR; \
+	int option = plan->option, less = plan->thresh_type == ESDM_FUNCTION_OP_LESS_THAN; \
+	int outlier = (option & ESDM_STAT_BIT(ESDM_STAT_OUTLIER)) && plan->has_scalar; \
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t)); \
+	if (!option)	/* No operation is executed in this case */ \
+		return; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv)) { \
+			if ((option & ESDM_STAT_BIT(ESDM_STAT_MIN)) && (v1 > a[idx])) \
+				v1 = a[idx]; \
+			if ((option & ESDM_STAT_BIT(ESDM_STAT_MAX)) && (v2 < a[idx])) \
+				v2 = a[idx]; \
+			if (option & ESDM_STAT_SQUARES) \
+				esdm_moments_add(tmp->number, &tmp->value3, &tmp->value4, a[idx]); \
+			else if (option & ESDM_STAT_SUMS) \
+				tmp->value3 += a[idx]; \
+			if (outlier && (less ? t > a[idx] : t < a[idx])) \
+				tmp->outlier++; \
+			tmp->number++; \
+		}) \
+	tmp->value1 = tmp->number ? v1 : 0; \
+	tmp->value2 = tmp->number ? v2 : 0; \
+	tmp->missing = f->n - tmp->number; \
+}
 
-	return 0;
+// The minimum and the maximum start from the bounds of the type, so that NaN elements are never selected
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_STAT, stat)
+
+#define ESDM_STREAM_OUTLIER(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, v = (TYPE) plan->SCALAR; \
+	tmp->value1 = 0; \
+	tmp->number = 1;	/* Use only to avoid errors during the reduction phase */ \
+	if (!plan->has_scalar)	/* No element is considered outlier in case the threshold is not given */ \
+		return; \
+	if (plan->thresh_type == ESDM_FUNCTION_OP_LESS_THAN) { \
+		ESDM_FOR_EACH_ELEMENT(f, \
+			if (ESDM_IS_VALID(MODE, a[idx], fv) && (v > a[idx])) \
+				tmp->value1++;) \
+	} else { \
+		ESDM_FOR_EACH_ELEMENT(f, \
+			if (ESDM_IS_VALID(MODE, a[idx], fv) && (v < a[idx])) \
+				tmp->value1++;) \
+	} \
 }
 
-void *esdm_stream_func(esdm_dataspace_t * space, void *buff, void *user_ptr, void *esdm_fill_value)
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_OUTLIER, outlier)
+
+// Histogram kernels: counters of the bins are followed by the counters of underflows, overflows and missing elements
+#define ESDM_HISTOGRAM_BLOCK 256
+
+// Bin of a value, where values out of range are counted as underflows or overflows, and NaN as overflows
+static inline int esdm_histogram_bin(const esdm_stream_plan_t * plan, double x)
 {
-	UNUSED(esdm_fill_value);
+	int first = 0, last = plan->bins, middle;
+	if (x < plan->edges[0])
+		return plan->bins;
+	if (plan->uniform) {
+		if (!(x < plan->edges[1]))
+			return plan->bins + 1;
+		middle = (int) ((x - plan->edges[0]) * plan->bins / (plan->edges[1] - plan->edges[0]));
+		return middle < plan->bins ? middle : plan->bins - 1;
+	}
+	if (!(x < plan->edges[plan->bins]))
+		return plan->bins + 1;
+	while (last - first > 1) {
+		middle = (first + last) / 2;
+		if (x < plan->edges[middle])
+			last = middle;
+		else
+			first = middle;
+	}
+	return first;
+}
 
-	if (!space || !buff || !user_ptr)
-		return NULL;
+#define ESDM_STREAM_HISTOGRAM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	uint64_t *count = (uint64_t *) f->out, i, j, len; \
+	int bins = plan->bins, bin[ESDM_HISTOGRAM_BLOCK]; \
+	double lo = plan->edges[0], hi = plan->edges[1], scale = bins / (hi - lo), b; \
+	UNUSED(tmp); \
+	if (!plan->uniform) { \
+		ESDM_FOR_EACH_ELEMENT(f, \
+			count[ESDM_IS_VALID(MODE, a[idx], fv) ? esdm_histogram_bin(plan, a[idx]) : bins + 2]++;) \
+		return; \
+	} \
+	/* Bins are evaluated block by block in a loop without branches, then counters are updated */ \
+	for (i = 0; i < f->n; i += len) { \
+		len = f->n - i < ESDM_HISTOGRAM_BLOCK ? f->n - i : ESDM_HISTOGRAM_BLOCK; \
+		for (j = 0; j < len; ++j) { \
+			b = ((double) a[i + j] - lo) * scale; \
+			b = b > 0 ? (b < bins - 1 ? b : bins - 1) : 0; \
+			bin[j] = a[i + j] < lo ? bins : (a[i + j] < hi ? (int) b : bins + 1); \
+			if ((MODE) != ESDM_FILL_NONE) \
+				bin[j] = ESDM_IS_VALID(MODE, a[i + j], fv) ? bin[j] : bins + 2; \
+		} \
+		for (j = 0; j < len; ++j) \
+			count[bin[j]]++; \
+	} \
+}
 
-	esdm_stream_data_t *stream_data = (esdm_stream_data_t *) user_ptr;
-	if (!stream_data->operation)
-		return NULL;
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_HISTOGRAM, histogram)
+
+// Quantile kernels: valid elements are added to the sketch following the header of the partial result
+#define ESDM_STREAM_QUANTILE(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	esdm_sketch_t *sketch = (esdm_sketch_t *) f->out; \
+	UNUSED(plan); \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv)) \
+			esdm_sketch_add(sketch, (double) a[idx]);) \
+	tmp->number = sketch->n; \
+}
 
-	char *args = stream_data->args ? strdup(stream_data->args) : NULL;	// Copy for strtok
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_QUANTILE, quantile)
 
-	int64_t i, idx, ndims = esdm_dataspace_get_dims(space);
-	int64_t const *s = esdm_dataspace_get_size(space);
-	//int64_t const *si = esdm_dataspace_get_offset(space);
-	int64_t ci[ndims], ei[ndims];
-	for (i = 0; i < ndims; ++i) {
-		ci[i] = 0;	// + si[i]
-		ei[i] = s[i];	// + si[i]
+// Count or collect the key of an element in case it belongs to a group: groups are disjoint, since all of them have the same shift
+static inline int esdm_percentile_add(esdm_percentile_t * state, uint64_t key, uint64_t * count)
+{
+	int g;
+	uint64_t i;
+	esdm_percentile_group_t *group;
+	for (g = 0, group = state->group; g < state->groups; ++g, ++group) {
+		if (group->shift && ((key ^ group->prefix) >> (64 - group->shift)))
+			continue;
+		if (!group->collect)
+			count[group->slot * ESDM_PERCENTILE_BINS + ((key << group->shift) >> (64 - ESDM_PERCENTILE_BITS))]++;
+		else if ((i = __atomic_fetch_add(&group->fill, 1, __ATOMIC_RELAXED)) < group->count)
+			state->data[group->offset + i] = key;
+		return 1;
 	}
+	return 0;
+}
 
-	uint64_t k = 1, n = esdm_dataspace_element_count(space);
-	esdm_type_t type = esdm_dataspace_get_type(space);
-	void *fill_value = stream_data->fill_value;
-	esdm_stream_data_out_t *tmp = NULL;
-
-	if (!strcmp(stream_data->operation, ESDM_FUNCTION_NOP) || !strcmp(stream_data->operation, ESDM_FUNCTION_STREAM)) {
+// Exact percentile kernels: keys of valid elements are counted by the histograms following the header of the partial result,
+// or collected into the state in the last pass
+#define ESDM_STREAM_PERCENTILE(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	esdm_percentile_t *state = (esdm_percentile_t *) plan->cells; \
+	uint64_t *count = (uint64_t *) f->out; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv) && (a[idx] == a[idx])) \
+			tmp->number += esdm_percentile_add(state, ESDM_KEY(TYPE, LOWEST, a[idx]), count);) \
+}
 
-		// TODO: copy only the data related to the dataspace
-		memcpy(stream_data->buff, buff, esdm_dataspace_total_bytes(space));
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_PERCENTILE, percentile)
+
+// Extremes with their position: ties are broken in favour of the first element in row-major order, while NaN elements are skipped as done by max and min
+#define ESDM_STREAM_ARG(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, CMP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE v = 0, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	tmp->number = 0; \
+	tmp->index = 0; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv) && (a[idx] == a[idx])) { \
+			if (!tmp->number || (v CMP a[idx])) { \
+				v = a[idx]; \
+				tmp->index = idx; \
+			} \
+			tmp->number++; \
+		}) \
+	tmp->value1 = v; \
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_MAX)) {
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_ARG, argmax, <)
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_ARG, argmin, >)
+
+// Distinct value kernels: valid elements are marked in the bitmap or added to the sketch following the header of the partial result.
+// Elements are identified by their order-preserving keys, where negative zeros are considered as zeros.
+#define ESDM_STREAM_DISTINCT(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	uint64_t *bitmap = (uint64_t *) f->out, key; \
+	uint8_t *reg = (uint8_t *) f->out; \
+	tmp->number = 0; \
+	if (ESDM_DISTINCT_EXACT(sizeof(TYPE))) { \
+		ESDM_FOR_EACH_ELEMENT(f, \
+			if (ESDM_IS_VALID(MODE, a[idx], fv)) { \
+				key = ESDM_KEY(TYPE, LOWEST, a[idx]) >> (64 - 8 * sizeof(TYPE)); \
+				bitmap[key >> 6] |= 1ULL << (key & 63); \
+				tmp->number++; \
+			}) \
+	} else { \
+		ESDM_FOR_EACH_ELEMENT(f, \
+			if (ESDM_IS_VALID(MODE, a[idx], fv)) { \
+				key = ESDM_KEY(TYPE, LOWEST, a[idx] == 0 ? (TYPE) 0 : a[idx]); \
+				esdm_distinct_add(reg, plan->precision, esdm_distinct_hash(key)); \
+				tmp->number++; \
+			}) \
+	} \
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 0;
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_DISTINCT, count_distinct)
 
-		if (type == SMD_DTYPE_INT8) {
+// Weight shared by the elements of a row, given the coordinates of its first element; base is set to the position of the row in the weight array
+static inline double esdm_weight_row(const esdm_fragment_t * f, const int64_t * ci, int64_t * base)
+{
+	int64_t i, b = 0, last = f->ndims - 1;
+	double row = 1;
+	for (i = 0; i < last; ++i)
+		if (f->weight_array)
+			b = b * f->extent[i] + f->origin[i] + ci[i];
+		else if (f->weights[i])
+			row *= f->weights[i][f->origin[i] + ci[i]];
+	*base = b * f->extent[last] + f->origin[last];
+	return row;
+}
 
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v < a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v < a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v < a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v < a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v < a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v < a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+// Visit the elements of a fragment (or of a block of it) row by row, setting idx to the position of the current one and w to its weight
+#define ESDM_FOR_EACH_WEIGHT(f, ...) { \
+	int64_t i, idx, base = 0, last = (f)->ndims - 1, ci[(f)->ndims]; \
+	uint64_t p = (f)->first; \
+	const double *wl = (f)->weight_array ? (f)->weight_array : (f)->weights[last] ? (f)->weights[last] + (f)->origin[last] : NULL; \
+	double w, row = 1; \
+	for (i = last; i >= 0; --i) { \
+		ci[i] = p % (f)->size[i]; \
+		p /= (f)->size[i]; \
+	} \
+	for (idx = 0; idx < (int64_t) (f)->n; ++idx) { \
+		if (!idx || !ci[last]) \
+			row = esdm_weight_row(f, ci, &base); \
+		w = (f)->weight_array ? wl[base + ci[last]] : wl ? row * wl[ci[last]] : row; \
+		__VA_ARGS__ \
+		if (++ci[last] < (f)->size[last]) \
+			continue; \
+		ci[last] = 0; \
+		for (i = last - 1; i >= 0; --i) { \
+			if (++ci[i] < (f)->size[i]) \
+				break; \
+			ci[i] = 0; \
+		} \
+	} \
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// Weighted reductions: the sum of the weights is tracked in value3
+#define ESDM_STREAM_WEIGHTED(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, SQUARES) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	tmp->value1 = 0; \
+	tmp->value2 = 0; \
+	tmp->value3 = 0; \
+	tmp->number = 0; \
+	ESDM_FOR_EACH_WEIGHT(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv)) { \
+			if (SQUARES) \
+				esdm_wmoments_add(&tmp->value3, &tmp->value1, &tmp->value2, w, a[idx]); \
+			else { \
+				tmp->value1 += w * a[idx]; \
+				tmp->value3 += w; \
+			} \
+			tmp->number++; \
+		}) \
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_MIN)) {
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_WEIGHTED, wsum, 0)
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_WEIGHTED, wmoments, 1)
+
+// Element-wise kernels: EXPR is evaluated on x, the value of the current element
+#define ESDM_STREAM_MAP(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, EXPR) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE x, v = 0, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, scalar = (TYPE) plan->SCALAR; \
+	size_t step = sizeof(v); \
+	UNUSED(scalar); \
+	tmp->number = 1; \
+	ESDM_FOR_EACH_ELEMENT(f, \
+		x = a[idx]; \
+		v = ESDM_IS_VALID(MODE, x, fv) ? (EXPR) : fv; \
+		memcpy(f->out + idx * step, &v, step);) \
+	tmp->value1 = v; \
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 0;
+// Element-wise operations: opcode, name and expression of the element x, where scalar is the argument
+#define ESDM_FOR_EACH_MAP(MACRO, ...) \
+	MACRO(ESDM_OP_SUM_SCALAR, sum_scalar, x + scalar, __VA_ARGS__) \
+	MACRO(ESDM_OP_MUL_SCALAR, mul_scalar, x * scalar, __VA_ARGS__) \
+	MACRO(ESDM_OP_ABS, abs, esdm_abs(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_SQR, sqr, x * x, __VA_ARGS__) \
+	MACRO(ESDM_OP_SQRT, sqrt, sqrt(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_CEIL, ceil, ceil(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_FLOOR, floor, floor(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_ROUND, round, floor(x + 0.5), __VA_ARGS__) \
+	MACRO(ESDM_OP_POW, pow, pow(x, scalar), __VA_ARGS__) \
+	MACRO(ESDM_OP_EXP, exp, exp(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_LOG, log, log(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_LOG10, log10, log10(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_SIN, sin, sin(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_COS, cos, cos(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_TAN, tan, tan(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_ASIN, asin, asin(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_ACOS, acos, acos(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_ATAN, atan, atan(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_SINH, sinh, sinh(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_COSH, cosh, cosh(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_TANH, tanh, tanh(x), __VA_ARGS__) \
+	MACRO(ESDM_OP_RECI, reci, 1.0 / x, __VA_ARGS__) \
+	MACRO(ESDM_OP_NOT, not, !x, __VA_ARGS__)
+
+#define ESDM_STREAM_MAP_ITEM(OPCODE, OP, EXPR, ...) ESDM_FOR_EACH_KERNEL(ESDM_STREAM_MAP, OP, EXPR)
+ESDM_FOR_EACH_MAP(ESDM_STREAM_MAP_ITEM, )
+
+// Chains of element-wise operations are applied block by block: each block is kept in the cache while all the operations
+// are applied, so that each element is read and written once
+#define ESDM_CHAIN_BLOCK ESDM_EXPR_BLOCK
+
+#define ESDM_CHAIN_STEP(OPCODE, OP, EXPR, MODE) \
+		case OPCODE: \
+			for (i = 0; i < n; ++i) { \
+				x = v[i]; \
+				v[i] = ESDM_IS_VALID(MODE, x, fv) ? (EXPR) : fv; \
+			} \
+			break;
 
-		if (type == SMD_DTYPE_INT8) {
+// Apply the operations of a chain to n elements of a fragment starting from first, at most ESDM_CHAIN_BLOCK
+#define ESDM_CHAIN_TRANSFORM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_transform_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, uint64_t first, void *out, uint64_t n) \
+{ \
+	TYPE x, *v = (TYPE *) out, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, scalar; \
+	double reg[plan->expr.registers > 0 ? plan->expr.registers : 1][ESDM_EXPR_BLOCK]; \
+	uint64_t i; \
+	int s; \
+	memcpy(v, (const TYPE *) f->in + first, n * sizeof(TYPE)); \
+	for (s = 0; s < plan->chain; ++s) { \
+		scalar = (TYPE) plan->steps[s].SCALAR; \
+		switch (plan->steps[s].opcode) { \
+			ESDM_FOR_EACH_MAP(ESDM_CHAIN_STEP, MODE) \
+			case ESDM_OP_EXPR: \
+				for (i = 0; i < n; ++i) \
+					reg[0][i] = v[i]; \
+				esdm_expr_run(&plan->expr, reg, (int) n); \
+				for (i = 0; i < n; ++i) \
+					v[i] = ESDM_IS_VALID(MODE, v[i], fv) ? (TYPE) reg[plan->expr.result][i] : fv; \
+				break; \
+			default: \
+				break; \
+		} \
+	} \
+}
 
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v > a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v > a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v > a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v > a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v > a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if ((!fill_value || (a[idx] != fv)) && (!tmp->number || (v > a[idx]))) {
-					v = a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+ESDM_FOR_EACH_KERNEL(ESDM_CHAIN_TRANSFORM, )
+
+#define ESDM_CHAIN_TRANSFORM_ITEM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, ...) { esdm_transform_##TNAME##_none, esdm_transform_##TNAME##_value, esdm_transform_##TNAME##_nan },
+static const esdm_transform_t esdm_chain_transforms[ESDM_TYPE_N][ESDM_FILL_N] = { ESDM_FOR_EACH_TYPE(ESDM_CHAIN_TRANSFORM_ITEM, ) };
+
+#define ESDM_STREAM_CHAIN(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	TYPE v[ESDM_CHAIN_BLOCK]; \
+	uint64_t first, n = 0; \
+	tmp->number = 1; \
+	for (first = 0; first < f->n; first += n) { \
+		n = f->n - first < ESDM_CHAIN_BLOCK ? f->n - first : ESDM_CHAIN_BLOCK; \
+		esdm_transform_##TNAME##_##MNAME(plan, f, first, v, n); \
+		memcpy(f->out + first * sizeof(TYPE), v, n * sizeof(TYPE)); \
+	} \
+	tmp->value1 = n ? v[n - 1] : 0; \
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_CHAIN, chain)
+
+// Expressions are evaluated in double precision by the program of the plan, on blocks of elements loaded into register 0
+#define ESDM_STREAM_EXPR(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_stream_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE v = 0, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	double reg[plan->expr.registers][ESDM_EXPR_BLOCK]; \
+	const double *r = reg[plan->expr.result]; \
+	uint64_t first, i, n = 0; \
+	tmp->number = 1; \
+	for (first = 0; first < f->n; first += n) { \
+		n = f->n - first < ESDM_EXPR_BLOCK ? f->n - first : ESDM_EXPR_BLOCK; \
+		for (i = 0; i < n; ++i) \
+			reg[0][i] = a[first + i]; \
+		esdm_expr_run(&plan->expr, reg, (int) n); \
+		for (i = 0; i < n; ++i) { \
+			v = ESDM_IS_VALID(MODE, a[first + i], fv) ? (TYPE) r[i] : fv; \
+			memcpy(f->out + (first + i) * sizeof(v), &v, sizeof(v)); \
+		} \
+	} \
+	tmp->value1 = v; \
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_AVG) || !strcmp(stream_data->operation, ESDM_FUNCTION_SUM)) {
+ESDM_FOR_EACH_KERNEL(ESDM_STREAM_EXPR, expr)
+
+static const esdm_stream_kernel_t esdm_stream_kernels[ESDM_OP_N][ESDM_TYPE_N][ESDM_FILL_N] = {
+	[ESDM_OP_MAX] = ESDM_KERNEL_ROW(esdm_stream, max),
+	[ESDM_OP_MIN] = ESDM_KERNEL_ROW(esdm_stream, min),
+	[ESDM_OP_AVG] = ESDM_KERNEL_ROW(esdm_stream, sum),
+	[ESDM_OP_SUM] = ESDM_KERNEL_ROW(esdm_stream, sum),
+	[ESDM_OP_STD] = ESDM_KERNEL_ROW(esdm_stream, moments),
+	[ESDM_OP_VAR] = ESDM_KERNEL_ROW(esdm_stream, moments),
+	[ESDM_OP_STAT] = ESDM_KERNEL_ROW(esdm_stream, stat),
+	[ESDM_OP_OUTLIER] = ESDM_KERNEL_ROW(esdm_stream, outlier),
+	[ESDM_OP_HISTOGRAM] = ESDM_KERNEL_ROW(esdm_stream, histogram),
+	[ESDM_OP_QUANTILE] = ESDM_KERNEL_ROW(esdm_stream, quantile),
+	[ESDM_OP_PERCENTILE] = ESDM_KERNEL_ROW(esdm_stream, percentile),
+	[ESDM_OP_ARGMAX] = ESDM_KERNEL_ROW(esdm_stream, argmax),
+	[ESDM_OP_ARGMIN] = ESDM_KERNEL_ROW(esdm_stream, argmin),
+	[ESDM_OP_COUNT_DISTINCT] = ESDM_KERNEL_ROW(esdm_stream, count_distinct),
+	[ESDM_OP_WSUM] = ESDM_KERNEL_ROW(esdm_stream, wsum),
+	[ESDM_OP_WAVG] = ESDM_KERNEL_ROW(esdm_stream, wsum),
+	[ESDM_OP_WSTD] = ESDM_KERNEL_ROW(esdm_stream, wmoments),
+	[ESDM_OP_WVAR] = ESDM_KERNEL_ROW(esdm_stream, wmoments),
+	[ESDM_OP_SUM_SCALAR] = ESDM_KERNEL_ROW(esdm_stream, sum_scalar),
+	[ESDM_OP_MUL_SCALAR] = ESDM_KERNEL_ROW(esdm_stream, mul_scalar),
+	[ESDM_OP_ABS] = ESDM_KERNEL_ROW(esdm_stream, abs),
+	[ESDM_OP_SQR] = ESDM_KERNEL_ROW(esdm_stream, sqr),
+	[ESDM_OP_SQRT] = ESDM_KERNEL_ROW(esdm_stream, sqrt),
+	[ESDM_OP_CEIL] = ESDM_KERNEL_ROW(esdm_stream, ceil),
+	[ESDM_OP_FLOOR] = ESDM_KERNEL_ROW(esdm_stream, floor),
+	[ESDM_OP_ROUND] = ESDM_KERNEL_ROW(esdm_stream, round),
+	[ESDM_OP_POW] = ESDM_KERNEL_ROW(esdm_stream, pow),
+	[ESDM_OP_EXP] = ESDM_KERNEL_ROW(esdm_stream, exp),
+	[ESDM_OP_LOG] = ESDM_KERNEL_ROW(esdm_stream, log),
+	[ESDM_OP_LOG10] = ESDM_KERNEL_ROW(esdm_stream, log10),
+	[ESDM_OP_SIN] = ESDM_KERNEL_ROW(esdm_stream, sin),
+	[ESDM_OP_COS] = ESDM_KERNEL_ROW(esdm_stream, cos),
+	[ESDM_OP_TAN] = ESDM_KERNEL_ROW(esdm_stream, tan),
+	[ESDM_OP_ASIN] = ESDM_KERNEL_ROW(esdm_stream, asin),
+	[ESDM_OP_ACOS] = ESDM_KERNEL_ROW(esdm_stream, acos),
+	[ESDM_OP_ATAN] = ESDM_KERNEL_ROW(esdm_stream, atan),
+	[ESDM_OP_SINH] = ESDM_KERNEL_ROW(esdm_stream, sinh),
+	[ESDM_OP_COSH] = ESDM_KERNEL_ROW(esdm_stream, cosh),
+	[ESDM_OP_TANH] = ESDM_KERNEL_ROW(esdm_stream, tanh),
+	[ESDM_OP_RECI] = ESDM_KERNEL_ROW(esdm_stream, reci),
+	[ESDM_OP_NOT] = ESDM_KERNEL_ROW(esdm_stream, not),
+	[ESDM_OP_CHAIN] = ESDM_KERNEL_ROW(esdm_stream, chain),
+	[ESDM_OP_EXPR] = ESDM_KERNEL_ROW(esdm_stream, expr),
+};
+
+// Axis-wise stream kernels: partial results are accumulated into the cells of the fragment projected on the dimensions not collapsed
+
+// Position of the cell of an element along a dimension, given its coordinate in the fragment
+#define ESDM_AXIS_COORD(f, i, c) ((i) == (f)->cyclic ? (c) % (f)->period : (c))
+
+// Visit the elements of a fragment row by row, setting idx to the position of the current element and cell to its output cell
+#define ESDM_FOR_EACH_CELL(f, ...) { \
+	int64_t i, j, base, idx = 0, last = (f)->ndims - 1, ci[(f)->ndims]; \
+	int64_t len = (f)->size[last], step = (f)->stride[last]; \
+	uint64_t k, rows = len ? (f)->n / len : 0; \
+	esdm_axis_cell_t *cell; \
+	for (i = 0; i < last; ++i) \
+		ci[i] = 0; \
+	for (k = 0; k < rows; ++k) { \
+		for (i = 0, base = 0; i < last; ++i) \
+			base += ESDM_AXIS_COORD(f, i, ci[i]) * (f)->stride[i]; \
+		for (j = 0; j < len; ++j, ++idx) { \
+			cell = (f)->cells + base + ESDM_AXIS_COORD(f, last, j) * step; \
+			__VA_ARGS__ \
+		} \
+		for (i = last - 1; i >= 0; --i) { \
+			if (++ci[i] < (f)->size[i]) \
+				break; \
+			ci[i] = 0; \
+		} \
+	} \
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->value1 = 0;
-		tmp->number = 0;
+#define ESDM_AXIS_EXTREME(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, CMP) \
+static void esdm_axis_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	UNUSED(tmp); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	ESDM_FOR_EACH_CELL(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv) && (a[idx] == a[idx])) { \
+			if (!cell->number || (cell->value1 CMP a[idx])) \
+				cell->value1 = a[idx]; \
+			cell->number++; \
+		}) \
+}
 
-		if (type == SMD_DTYPE_INT8) {
+// NaN elements are skipped, as done by max and min along all the dimensions
+ESDM_FOR_EACH_KERNEL(ESDM_AXIS_EXTREME, max, <)
+ESDM_FOR_EACH_KERNEL(ESDM_AXIS_EXTREME, min, >)
+
+#define ESDM_AXIS_MOMENTS(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, SQUARES) \
+static void esdm_axis_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	UNUSED(tmp); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	ESDM_FOR_EACH_CELL(f, \
+		if (ESDM_IS_VALID(MODE, a[idx], fv)) { \
+			if (SQUARES) \
+				esdm_moments_add(cell->number, &cell->value1, &cell->value2, a[idx]); \
+			else \
+				cell->value1 += a[idx]; \
+			cell->number++; \
+		}) \
+}
 
-			char *a = (char *) buff, fv = fill_value ? *(char *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+ESDM_FOR_EACH_KERNEL(ESDM_AXIS_MOMENTS, sum, 0)
+ESDM_FOR_EACH_KERNEL(ESDM_AXIS_MOMENTS, moments, 1)
+
+static const esdm_stream_kernel_t esdm_axis_kernels[ESDM_OP_N][ESDM_TYPE_N][ESDM_FILL_N] = {
+	[ESDM_OP_MAX] = ESDM_KERNEL_ROW(esdm_axis, max),
+	[ESDM_OP_MIN] = ESDM_KERNEL_ROW(esdm_axis, min),
+	[ESDM_OP_AVG] = ESDM_KERNEL_ROW(esdm_axis, sum),
+	[ESDM_OP_SUM] = ESDM_KERNEL_ROW(esdm_axis, sum),
+	[ESDM_OP_STD] = ESDM_KERNEL_ROW(esdm_axis, moments),
+	[ESDM_OP_VAR] = ESDM_KERNEL_ROW(esdm_axis, moments),
+};
+
+// Rolling stream kernels: the window of each position t along the sliding dimension holds the elements from t - window + 1 to t.
+// Cells cover the positions of the fragment extended by window - 1, as the windows of the positions following the fragment
+// include its last elements: they are the state carried to the next fragments, merged by esdm_rolling_reduce
+
+// Size of the fragment as outer dimensions, sliding dimension and inner dimensions
+#define ESDM_ROLLING_SHAPE(plan, f) \
+	int64_t i, k, t, outer = 1, inner = 1, len = (f)->size[(plan)->window_dim], w = (plan)->window, ext = len + w - 1; \
+	for (i = 0; i < (plan)->window_dim; ++i) \
+		outer *= (f)->size[i]; \
+	for (i = (plan)->window_dim + 1; i < (f)->ndims; ++i) \
+		inner *= (f)->size[i];
+
+// Sums are updated at each position by adding the element entering the window and subtracting the one leaving it,
+// row by row along the sliding dimension: NaN elements are skipped, as they would spoil the sums of all the following windows
+#define ESDM_ROLLING_SUM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_rolling_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(tmp); \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	ESDM_ROLLING_SHAPE(plan, f) \
+	for (i = 0; i < outer; ++i) { \
+		const TYPE *a = (const TYPE *) f->in + i * len * inner; \
+		esdm_axis_cell_t *cell = f->cells + i * ext * inner, *prev = NULL; \
+		for (t = 0; t < ext; ++t, prev = cell, cell += inner) \
+			for (k = 0; k < inner; ++k) { \
+				double sum = prev ? prev[k].value1 : 0; \
+				uint64_t n = prev ? prev[k].number : 0; \
+				if ((t < len) && ESDM_IS_VALID(MODE, a[t * inner + k], fv) && (a[t * inner + k] == a[t * inner + k])) { \
+					sum += a[t * inner + k]; \
+					n++; \
+				} \
+				if ((t >= w) && ESDM_IS_VALID(MODE, a[(t - w) * inner + k], fv) && (a[(t - w) * inner + k] == a[(t - w) * inner + k])) { \
+					sum -= a[(t - w) * inner + k]; \
+					n--; \
+				} \
+				cell[k].value1 = n ? sum : 0; \
+				cell[k].number = n; \
+			} \
+	} \
+}
 
-		} else if (type == SMD_DTYPE_INT16) {
+ESDM_FOR_EACH_KERNEL(ESDM_ROLLING_SUM, sum)
+
+// Extremes are tracked by a monotonic deque of positions for each row along the sliding dimension, so that each element
+// is pushed and popped once: f->out points to the room of the deques. NaN elements are skipped as done by max and min,
+// since they would otherwise never be popped
+#define ESDM_ROLLING_EXTREME(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, CMP) \
+static void esdm_rolling_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(tmp); \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	ESDM_ROLLING_SHAPE(plan, f) \
+	int64_t cap = w < len ? w : len, *head = (int64_t *) f->out, *count = head + inner, *deque = count + inner; \
+	for (i = 0; i < outer; ++i) { \
+		const TYPE *a = (const TYPE *) f->in + i * len * inner; \
+		esdm_axis_cell_t *cell = f->cells + i * ext * inner; \
+		memset(head, 0, 2 * inner * sizeof(int64_t)); \
+		for (t = 0; t < ext; ++t, cell += inner) \
+			for (k = 0; k < inner; ++k) { \
+				int64_t *q = deque + k * cap, h = head[k], n = count[k]; \
+				if (n && (q[h] <= t - w)) { \
+					h = h + 1 < cap ? h + 1 : 0; \
+					n--; \
+				} \
+				if ((t < len) && ESDM_IS_VALID(MODE, a[t * inner + k], fv) && (a[t * inner + k] == a[t * inner + k])) { \
+					while (n && !(a[q[(h + n - 1) % cap] * inner + k] CMP a[t * inner + k])) \
+						n--; \
+					q[(h + n) % cap] = t; \
+					n++; \
+				} \
+				if (n) { \
+					cell[k].value1 = a[q[h] * inner + k]; \
+					cell[k].number = 1; \
+				} \
+				head[k] = h; \
+				count[k] = n; \
+			} \
+	} \
+}
 
-			short *a = (short *) buff, fv = fill_value ? *(short *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+ESDM_FOR_EACH_KERNEL(ESDM_ROLLING_EXTREME, max, >)
+ESDM_FOR_EACH_KERNEL(ESDM_ROLLING_EXTREME, min, <)
+
+static const esdm_stream_kernel_t esdm_rolling_kernels[ESDM_OP_N][ESDM_TYPE_N][ESDM_FILL_N] = {
+	[ESDM_OP_ROLLING_SUM] = ESDM_KERNEL_ROW(esdm_rolling, sum),
+	[ESDM_OP_ROLLING_AVG] = ESDM_KERNEL_ROW(esdm_rolling, sum),
+	[ESDM_OP_ROLLING_MIN] = ESDM_KERNEL_ROW(esdm_rolling, min),
+	[ESDM_OP_ROLLING_MAX] = ESDM_KERNEL_ROW(esdm_rolling, max),
+};
+
+// Store a value into the output buffer of axis-wise reductions
+#define ESDM_AXIS_STORE(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, ...) \
+static void esdm_axis_store_##TNAME(void *buff, int64_t i, double value) \
+{ \
+	TYPE v = (TYPE) value; \
+	memcpy((char *) buff + i * sizeof(v), &v, sizeof(v)); \
+}
 
-		} else if (type == SMD_DTYPE_INT32) {
+ESDM_FOR_EACH_TYPE(ESDM_AXIS_STORE, )
 
-			int *a = (int *) buff, fv = fill_value ? *(int *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+#define ESDM_AXIS_STORE_ITEM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, ...) esdm_axis_store_##TNAME,
+static void (*const esdm_axis_store[ESDM_TYPE_N])(void *, int64_t, double) = { ESDM_FOR_EACH_TYPE(ESDM_AXIS_STORE_ITEM, ) };
 
-		} else if (type == SMD_DTYPE_INT64) {
+// Reduce kernels
 
-			long long *a = (long long *) buff, fv = fill_value ? *(long long *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Merge a partial result into the partial result of the blocks (or fragments) preceding it
+static void esdm_stream_merge(const esdm_stream_plan_t * plan, esdm_stream_data_out_t * dst, const esdm_stream_data_out_t * src)
+{
+	if (!src->number && (plan->opcode != ESDM_OP_STAT))
+		return;
+
+	switch (plan->opcode) {
+		case ESDM_OP_MAX:
+			if (!dst->number || (dst->value1 < src->value1))
+				dst->value1 = src->value1;
+			dst->number += src->number;
+			break;
+		case ESDM_OP_MIN:
+			if (!dst->number || (dst->value1 > src->value1))
+				dst->value1 = src->value1;
+			dst->number += src->number;
+			break;
+		case ESDM_OP_AVG:
+		case ESDM_OP_SUM:
+			dst->value1 += src->value1;
+			dst->number += src->number;
+			break;
+		case ESDM_OP_STD:
+		case ESDM_OP_VAR:
+			esdm_moments_merge(&dst->number, &dst->value1, &dst->value2, src->number, src->value1, src->value2);
+			break;
+		case ESDM_OP_STAT:
+			if (src->number) {
+				if (!dst->number || (dst->value1 > src->value1))
+					dst->value1 = src->value1;
+				if (!dst->number || (dst->value2 < src->value2))
+					dst->value2 = src->value2;
+			}
+			esdm_moments_merge(&dst->number, &dst->value3, &dst->value4, src->number, src->value3, src->value4);
+			dst->missing += src->missing;
+			dst->outlier += src->outlier;
+			break;
+		case ESDM_OP_OUTLIER:
+			dst->value1 += src->value1;
+			dst->number = 1;
+			break;
+		case ESDM_OP_WSUM:
+		case ESDM_OP_WAVG:
+			dst->value1 += src->value1;
+			dst->value3 += src->value3;
+			dst->number += src->number;
+			break;
+		case ESDM_OP_WSTD:
+		case ESDM_OP_WVAR:
+			esdm_wmoments_merge(&dst->value3, &dst->value1, &dst->value2, src->value3, src->value1, src->value2);
+			dst->number += src->number;
+			break;
+		case ESDM_OP_ARGMAX:
+		case ESDM_OP_ARGMIN:
+			// Partial results are merged in order, so that the first extreme is kept in case of ties
+			if (!dst->number || ((plan->opcode == ESDM_OP_ARGMAX) ? dst->value1 < src->value1 : dst->value1 > src->value1)) {
+				dst->value1 = src->value1;
+				dst->index = src->index;
+			}
+			dst->number += src->number;
+			break;
+		default:	// Element-wise operations carry the value of the last element
+			*dst = *src;
+			break;
+	}
+}
 
-		} else if (type == SMD_DTYPE_FLOAT) {
 
-			float *a = (float *) buff, fv = fill_value ? *(float *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+#define ESDM_REDUCE_EXTREME(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP, CMP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	TYPE v = (TYPE) tmp->value1, pre; \
+	if (stream_data->valid) { \
+		pre = *(TYPE *) stream_data->buff; \
+		if (pre CMP v) \
+			memcpy(stream_data->buff, &v, sizeof(v)); \
+	} else { \
+		memcpy(stream_data->buff, &v, sizeof(v)); \
+		stream_data->valid = 1; \
+	} \
+}
 
-		} else if (type == SMD_DTYPE_DOUBLE) {
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_EXTREME, max, <)
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_EXTREME, min, >)
+
+// Accumulate the partial sum; the number of elements is considered only for averages
+#define ESDM_REDUCE_SUM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP, AVERAGE) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	if (!stream_data->valid) { \
+		stream_data->valid = 1; \
+		stream_data->value1 = 0; \
+		stream_data->number = 0; \
+	} \
+	stream_data->value1 += tmp->value1; \
+	if (AVERAGE) \
+		stream_data->number += tmp->number; \
+	else \
+		stream_data->number = 1; \
+	TYPE v = (TYPE) (stream_data->value1 / stream_data->number); \
+	memcpy(stream_data->buff, &v, sizeof(v)); \
+}
 
-			double *a = (double *) buff, fv = fill_value ? *(double *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_SUM, avg, 1)
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_SUM, sum, 0)
+
+#define ESDM_REDUCE_MOMENTS(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP, ROOT) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	if (!stream_data->valid) { \
+		stream_data->valid = 1; \
+		stream_data->value1 = 0; \
+		stream_data->value2 = 0; \
+		stream_data->number = 0; \
+	} \
+	esdm_moments_merge(&stream_data->number, &stream_data->value1, &stream_data->value2, tmp->number, tmp->value1, tmp->value2); \
+	double result = stream_data->number > 1 ? stream_data->value2 / (stream_data->number - 1.0) : 0; \
+	if (ROOT) \
+		result = sqrt(result); \
+	TYPE v = (TYPE) result; \
+	memcpy(stream_data->buff, &v, sizeof(v)); \
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_MOMENTS, std, 1)
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_MOMENTS, var, 0)
+
+#define ESDM_REDUCE_STAT(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	esdm_stream_data_out_t *stat = &stream_data->context->stat; \
+	int i, option = plan->option; \
+	double n, values[ESDM_STAT_N]; \
+	size_t offset = 0; \
+	TYPE v; \
+	if (!stream_data->valid) { \
+		stream_data->valid = 1; \
+		memset(stat, 0, sizeof(esdm_stream_data_out_t)); \
+	} \
+	esdm_stream_merge(plan, stat, tmp); \
+	n = stat->number; \
+	values[ESDM_STAT_MIN] = n ? stat->value1 : 0; \
+	values[ESDM_STAT_MAX] = n ? stat->value2 : 0; \
+	values[ESDM_STAT_AVG] = n ? stat->value3 / n : 0; \
+	values[ESDM_STAT_VAR] = n > 1 ? stat->value4 / (n - 1) : 0; \
+	values[ESDM_STAT_STD] = sqrt(values[ESDM_STAT_VAR]); \
+	values[ESDM_STAT_SUM] = stat->value3; \
+	values[ESDM_STAT_COUNT] = n; \
+	values[ESDM_STAT_MISSING] = stat->missing; \
+	values[ESDM_STAT_OUTLIER] = stat->outlier; \
+	for (i = 0; i < ESDM_STAT_COUNT; ++i) \
+		if (option & ESDM_STAT_BIT(i)) { \
+			v = (TYPE) values[i]; \
+			memcpy(stream_data->buff + offset, &v, sizeof(v)); \
+			offset += sizeof(v); \
+		} \
+	/* Counters are not bounded by the type, so they follow as int64_t, aligned to their size */ \
+	offset = (offset + sizeof(int64_t) - 1) / sizeof(int64_t) * sizeof(int64_t); \
+	for (i = ESDM_STAT_COUNT; i < ESDM_STAT_N; ++i) \
+		if (option & ESDM_STAT_BIT(i)) { \
+			int64_t c = (int64_t) values[i]; \
+			memcpy(stream_data->buff + offset, &c, sizeof(c)); \
+			offset += sizeof(c); \
+		} \
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_STD) || !strcmp(stream_data->operation, ESDM_FUNCTION_VAR)) {
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_STAT, stat)
+
+// Weighted reductions accumulate the partial results into the running statistics; weighted variances are normalized by the sum of the weights
+#define ESDM_REDUCE_WEIGHTED(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	esdm_stream_data_out_t *acc = &stream_data->context->stat; \
+	double result; \
+	TYPE v; \
+	if (!stream_data->valid) { \
+		stream_data->valid = 1; \
+		memset(acc, 0, sizeof(esdm_stream_data_out_t)); \
+	} \
+	esdm_stream_merge(plan, acc, tmp); \
+	switch (plan->opcode) { \
+		case ESDM_OP_WAVG: \
+			result = acc->value3 != 0 ? acc->value1 / acc->value3 : 0; \
+			break; \
+		case ESDM_OP_WSTD: \
+		case ESDM_OP_WVAR: \
+			result = acc->value3 != 0 ? acc->value2 / acc->value3 : 0; \
+			if (plan->opcode == ESDM_OP_WSTD) \
+				result = sqrt(result); \
+			break; \
+		default: \
+			result = acc->value1; \
+			break; \
+	} \
+	v = (TYPE) result; \
+	memcpy(stream_data->buff, &v, sizeof(v)); \
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->value1 = 0;
-		tmp->value2 = 0;
-		tmp->number = 0;
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_WEIGHTED, weighted)
 
-		if (type == SMD_DTYPE_INT8) {
+// Accumulator of histograms and sketches, allocated on first use
+static void *esdm_stream_accumulator(esdm_stream_plan_t * plan)
+{
+	if (plan->cells)
+		return plan->cells;
+	if (plan->opcode == ESDM_OP_HISTOGRAM)
+		plan->cells = calloc(plan->reduce, sizeof(uint64_t));
+	else if ((plan->opcode == ESDM_OP_QUANTILE) && (plan->cells = malloc(esdm_sketch_bytes(plan->sketch_size))))
+		esdm_sketch_init((esdm_sketch_t *) plan->cells, plan->sketch_size);
+	else if ((plan->opcode == ESDM_OP_ARGMAX) || (plan->opcode == ESDM_OP_ARGMIN))
+		plan->cells = calloc(1, sizeof(esdm_arg_t));
+	else if (plan->opcode == ESDM_OP_COUNT_DISTINCT)
+		plan->cells = calloc(1, sizeof(esdm_distinct_t) + (1ULL << plan->precision));
+	else if ((plan->opcode == ESDM_OP_PERCENTILE) && (plan->cells = calloc(1, sizeof(esdm_percentile_t) + ESDM_PERCENTILE_BINS * sizeof(uint64_t)))) {
+		// The first pass counts all the elements by a single histogram
+		esdm_percentile_t *state = (esdm_percentile_t *) plan->cells;
+		state->groups = state->slots = 1;
+		state->pending = plan->reduce;
+	}
+	return plan->cells;
+}
 
-			char *a = (char *) buff, fv = fill_value ? *(char *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->value2 += a[idx] * a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Add the histograms of a partial result to the counters of the groups
+static void esdm_percentile_merge(esdm_percentile_t * state, const esdm_stream_data_out_t * tmp, char concurrent)
+{
+	int g, i;
+	const uint64_t *count = (const uint64_t *) (tmp + 1);
+	for (g = 0; g < state->groups; ++g) {
+		if (state->group[g].collect)
+			continue;
+		uint64_t *acc = state->data + state->group[g].offset;
+		const uint64_t *partial = count + state->group[g].slot * ESDM_PERCENTILE_BINS;
+		for (i = 0; i < ESDM_PERCENTILE_BINS; ++i)
+			if (!partial[i])
+				continue;
+			else if (concurrent)
+				__atomic_add_fetch(acc + i, partial[i], __ATOMIC_RELAXED);
+			else
+				acc[i] += partial[i];
+	}
+}
 
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, fv = fill_value ? *(short *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->value2 += a[idx] * a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Counters of the partial result (if any) are added to the accumulators, then they are written into the output buffer
+#define ESDM_REDUCE_HISTOGRAM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	int i, n = plan->bins + 3; \
+	uint64_t *count = (uint64_t *) esdm_stream_accumulator(plan); \
+	TYPE v; \
+	if (!count) \
+		return; \
+	if (tmp) \
+		for (i = 0; i < n; ++i) \
+			count[i] += ((const uint64_t *) (tmp + 1))[i]; \
+	for (i = 0; i < n; ++i) { \
+		/* Counters saturate in case they cannot be represented by the type */ \
+		v = count[i] > (HIGHEST) ? (TYPE) (HIGHEST) : (TYPE) count[i]; \
+		memcpy(stream_data->buff + i * sizeof(v), &v, sizeof(v)); \
+	} \
+	stream_data->valid = 1; \
+}
 
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, fv = fill_value ? *(int *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->value2 += a[idx] * a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_HISTOGRAM, histogram)
+
+// The sketch of the partial result (if any) is merged, then the quantiles are written into the output buffer
+#define ESDM_REDUCE_QUANTILE(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	int i; \
+	double q[ESDM_QUANTILES_MAX]; \
+	TYPE v; \
+	esdm_sketch_t *sketch = (esdm_sketch_t *) esdm_stream_accumulator(plan); \
+	if (!sketch || (tmp && esdm_sketch_merge(sketch, (const esdm_sketch_t *) (tmp + 1)))) \
+		return; \
+	if (!sketch->n || esdm_sketch_quantiles(sketch, plan->quantiles, plan->reduce, q)) \
+		return; \
+	for (i = 0; i < plan->reduce; ++i) { \
+		v = q[i] >= (double) (HIGHEST) ? (TYPE) (HIGHEST) : q[i] <= (double) (LOWEST) ? (TYPE) (LOWEST) : (TYPE) q[i]; \
+		memcpy(stream_data->buff + i * sizeof(v), &v, sizeof(v)); \
+	} \
+	stream_data->valid = 1; \
+}
 
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, fv = fill_value ? *(long long *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->value2 += a[idx] * a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_QUANTILE, quantile)
+
+// Histograms of the partial result are merged, while the percentiles are written into the output buffer once all of them are found
+#define ESDM_REDUCE_PERCENTILE(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	int i; \
+	TYPE v; \
+	esdm_percentile_t *state = (esdm_percentile_t *) plan->cells; \
+	if (!state) \
+		return; \
+	if (tmp) { \
+		esdm_percentile_merge(state, tmp, 0); \
+		return; \
+	} \
+	if (state->pending) \
+		return; \
+	for (i = 0; i < plan->reduce; ++i) { \
+		ESDM_KEY_VALUE(TYPE, LOWEST, v, state->key[i]); \
+		memcpy(stream_data->buff + i * sizeof(v), &v, sizeof(v)); \
+	} \
+	stream_data->valid = 1; \
+}
 
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, fv = fill_value ? *(float *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->value2 += a[idx] * a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_PERCENTILE, percentile)
 
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, fv = fill_value ? *(double *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					tmp->value1 += a[idx];
-					tmp->value2 += a[idx] * a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Check whether the extreme of a partial result has to replace the one of the accumulator: ties are broken by the global coordinates
+static int esdm_arg_precedes(int opcode, const esdm_stream_data_out_t * tmp, const esdm_arg_t * acc)
+{
+	int64_t i;
+	const int64_t *coord = (const int64_t *) (tmp + 1);
+	if (!acc->head.number)
+		return 1;
+	if (tmp->value1 != acc->head.value1)
+		return opcode == ESDM_OP_ARGMAX ? tmp->value1 > acc->head.value1 : tmp->value1 < acc->head.value1;
+	for (i = 0; i < tmp->dims; ++i)
+		if (coord[i] != acc->coord[i])
+			return coord[i] < acc->coord[i];
+	return 0;
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+static void esdm_arg_merge(int opcode, esdm_arg_t * acc, const esdm_stream_data_out_t * tmp)
+{
+	if (esdm_arg_precedes(opcode, tmp, acc)) {
+		acc->head.value1 = tmp->value1;
+		acc->head.dims = tmp->dims;
+		memcpy(acc->coord, tmp + 1, tmp->dims * sizeof(int64_t));
+	}
+	acc->head.number += tmp->number;
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_STAT)) {
+// The extreme of the partial result (if any) is merged, then it is written into the output buffer with its coordinates
+#define ESDM_REDUCE_ARG(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	esdm_arg_t *acc = (esdm_arg_t *) esdm_stream_accumulator(plan); \
+	TYPE v; \
+	if (!acc) \
+		return; \
+	if (tmp) \
+		esdm_arg_merge(plan->opcode, acc, tmp); \
+	if (!acc->head.number) \
+		return; \
+	v = (TYPE) acc->head.value1; \
+	memcpy(stream_data->buff, &v, sizeof(v)); \
+	memcpy((char *) stream_data->buff + ESDM_ARG_COORDINATES_OFFSET, acc->coord, acc->head.dims * sizeof(int64_t)); \
+	stream_data->valid = 1; \
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->value3 = 0;
-		tmp->number = 0;
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_ARG, arg)
 
-		char *save_pointer = NULL, *arg = args ? strtok_r(args, ESDM_SEPARATOR, &save_pointer) : NULL;
-		char i, option = 0, tbyte = 1;
-		for (i = 0; i < ESDM_FUNCTION_OP_N; ++i)
-			if (arg && arg[0]) {
-				if (arg[0] == ESDM_FUNCTION_OP_SET)
-					option |= tbyte;
-				arg++;
-				tbyte <<= 1;
-			} else
-				break;
-		if (!option) {
-
-			// No operation is executed in this case
-
-		} else if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v1 = 0, v2 = 0, fv = fill_value ? *(char *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					if ((option & 1) && (!tmp->number || (v1 > a[idx])))	// Min
-						v1 = a[idx];
-					if ((option & 2) && (!tmp->number || (v2 < a[idx])))	// Max
-						v2 = a[idx];
-					if (option & 4)	// Avg
-						tmp->value3 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v1;
-			tmp->value2 = v2;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v1 = 0, v2 = 0, fv = fill_value ? *(short *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					if ((option & 1) && (!tmp->number || (v1 > a[idx])))	// Min
-						v1 = a[idx];
-					if ((option & 2) && (!tmp->number || (v2 < a[idx])))	// Max
-						v2 = a[idx];
-					if (option & 4)	// Avg
-						tmp->value3 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v1;
-			tmp->value2 = v2;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v1 = 0, v2 = 0, fv = fill_value ? *(int *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					if ((option & 1) && (!tmp->number || (v1 > a[idx])))	// Min
-						v1 = a[idx];
-					if ((option & 2) && (!tmp->number || (v2 < a[idx])))	// Max
-						v2 = a[idx];
-					if (option & 4)	// Avg
-						tmp->value3 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v1;
-			tmp->value2 = v2;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v1 = 0, v2 = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					if ((option & 1) && (!tmp->number || (v1 > a[idx])))	// Min
-						v1 = a[idx];
-					if ((option & 2) && (!tmp->number || (v2 < a[idx])))	// Max
-						v2 = a[idx];
-					if (option & 4)	// Avg
-						tmp->value3 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v1;
-			tmp->value2 = v2;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v1 = 0, v2 = 0, fv = fill_value ? *(float *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					if ((option & 1) && (!tmp->number || (v1 > a[idx])))	// Min
-						v1 = a[idx];
-					if ((option & 2) && (!tmp->number || (v2 < a[idx])))	// Max
-						v2 = a[idx];
-					if (option & 4)	// Avg
-						tmp->value3 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v1;
-			tmp->value2 = v2;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v1 = 0, v2 = 0, fv = fill_value ? *(double *) fill_value : 0;
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv)) {
-					if ((option & 1) && (!tmp->number || (v1 > a[idx])))	// Min
-						v1 = a[idx];
-					if ((option & 2) && (!tmp->number || (v2 < a[idx])))	// Max
-						v2 = a[idx];
-					if (option & 4)	// Avg
-						tmp->value3 += a[idx];
-					tmp->number++;
-				}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
+// Merge the bitmap or the registers of a partial result, given the size of the elements
+static void esdm_distinct_merge(const esdm_stream_plan_t * plan, esdm_distinct_t * acc, const esdm_stream_data_out_t * tmp, size_t size)
+{
+	uint64_t i, n;
+	if (ESDM_DISTINCT_EXACT(size)) {
+		const uint64_t *bitmap = (const uint64_t *) (tmp + 1);
+		for (i = 0, n = ESDM_DISTINCT_WORDS(size); i < n; ++i)
+			if (!bitmap[i])
+				continue;
+			else if (plan->concurrent)
+				__atomic_fetch_or(acc->bitmap + i, bitmap[i], __ATOMIC_RELAXED);
+			else
+				acc->bitmap[i] |= bitmap[i];
+	} else {
+		const uint8_t *reg = (const uint8_t *) (tmp + 1);
+		uint8_t cur;
+		for (i = 0, n = 1ULL << plan->precision; i < n; ++i)
+			if (!plan->concurrent) {
+				if (acc->reg[i] < reg[i])
+					acc->reg[i] = reg[i];
+			} else {
+				cur = __atomic_load_n(acc->reg + i, __ATOMIC_RELAXED);
+				while ((cur < reg[i]) && !__atomic_compare_exchange_n(acc->reg + i, &cur, reg[i], 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 			}
-			tmp->value1 = v1;
-			tmp->value2 = v2;
+	}
+	__atomic_add_fetch(&acc->number, tmp->number, __ATOMIC_RELAXED);
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// The bitmap or the sketch of the partial result (if any) is merged, then the number of distinct values is written into the output buffer
+#define ESDM_REDUCE_DISTINCT(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, OP) \
+static void esdm_reduce_##OP##_##TNAME(esdm_stream_data_t *stream_data, const esdm_stream_data_out_t *tmp) \
+{ \
+	esdm_stream_plan_t *plan = &stream_data->context->plan; \
+	uint64_t i, words = ESDM_DISTINCT_WORDS(sizeof(TYPE)); \
+	double count = 0; \
+	int64_t v; \
+	esdm_distinct_t *acc = (esdm_distinct_t *) esdm_stream_accumulator(plan); \
+	if (!acc) \
+		return; \
+	if (tmp) \
+		esdm_distinct_merge(plan, acc, tmp, sizeof(TYPE)); \
+	if (ESDM_DISTINCT_EXACT(sizeof(TYPE))) \
+		for (i = 0; i < words; ++i) \
+			count += __builtin_popcountll(acc->bitmap[i]); \
+	else if (acc->number) \
+		count = round(esdm_distinct_estimate(acc->reg, plan->precision)); \
+	/* The number is not bounded by the type, e.g. 256 values of an 8-bit type */ \
+	v = (int64_t) count; \
+	memcpy(stream_data->buff, &v, sizeof(v)); \
+	stream_data->valid = 1; \
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_OUTLIER)) {
+ESDM_FOR_EACH_TYPE(ESDM_REDUCE_DISTINCT, count_distinct)
+
+static const esdm_reduce_kernel_t esdm_reduce_kernels[ESDM_OP_N][ESDM_TYPE_N] = {
+	[ESDM_OP_MAX] = ESDM_TYPE_ROW(esdm_reduce, max),
+	[ESDM_OP_MIN] = ESDM_TYPE_ROW(esdm_reduce, min),
+	[ESDM_OP_AVG] = ESDM_TYPE_ROW(esdm_reduce, avg),
+	[ESDM_OP_SUM] = ESDM_TYPE_ROW(esdm_reduce, sum),
+	[ESDM_OP_STD] = ESDM_TYPE_ROW(esdm_reduce, std),
+	[ESDM_OP_VAR] = ESDM_TYPE_ROW(esdm_reduce, var),
+	[ESDM_OP_STAT] = ESDM_TYPE_ROW(esdm_reduce, stat),
+	[ESDM_OP_OUTLIER] = ESDM_TYPE_ROW(esdm_reduce, sum),
+	[ESDM_OP_HISTOGRAM] = ESDM_TYPE_ROW(esdm_reduce, histogram),
+	[ESDM_OP_QUANTILE] = ESDM_TYPE_ROW(esdm_reduce, quantile),
+	[ESDM_OP_PERCENTILE] = ESDM_TYPE_ROW(esdm_reduce, percentile),
+	[ESDM_OP_ARGMAX] = ESDM_TYPE_ROW(esdm_reduce, arg),
+	[ESDM_OP_ARGMIN] = ESDM_TYPE_ROW(esdm_reduce, arg),
+	[ESDM_OP_COUNT_DISTINCT] = ESDM_TYPE_ROW(esdm_reduce, count_distinct),
+	[ESDM_OP_WSUM] = ESDM_TYPE_ROW(esdm_reduce, weighted),
+	[ESDM_OP_WAVG] = ESDM_TYPE_ROW(esdm_reduce, weighted),
+	[ESDM_OP_WSTD] = ESDM_TYPE_ROW(esdm_reduce, weighted),
+	[ESDM_OP_WVAR] = ESDM_TYPE_ROW(esdm_reduce, weighted),
+};
+
+// Check whether a partial result has nothing to be merged
+static int esdm_stream_is_empty(const esdm_stream_plan_t * plan, const esdm_stream_data_out_t * tmp)
+{
+	return !tmp->number && ((plan->opcode != ESDM_OP_STAT) || !tmp->missing);
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->value1 = 0;
-		tmp->number = 1;	// Use only to avoid errors during the reduction phase
+static void esdm_atomic_add(double *dst, double v)
+{
+	double cur, next;
+	__atomic_load(dst, &cur, __ATOMIC_RELAXED);
+	do
+		next = cur + v;
+	while (!__atomic_compare_exchange(dst, &cur, &next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
 
-		char *save_pointer = NULL, *arg = args ? strtok_r(args, ESDM_SEPARATOR, &save_pointer) : NULL;
-		char thresh_type = ESDM_FUNCTION_OP_MORE_THAN;
-		if (arg) {
-			if (!isdigit(arg[0])) {
-				if (arg[0] == ESDM_FUNCTION_OP_LESS_THAN)
-					thresh_type = ESDM_FUNCTION_OP_LESS_THAN;
-				arg++;
-			}
-		}
-		if (!arg || !arg[0]) {
-
-			// No element is considered outlier in case the threshold is not given
-
-		} else if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, fv = fill_value ? *(char *) fill_value : 0, v = strtol(arg, NULL, 10);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv))
-					switch (thresh_type) {
-						case ESDM_FUNCTION_OP_LESS_THAN:
-							if (v > a[idx])
-								tmp->value1++;
-							break;
-						case ESDM_FUNCTION_OP_MORE_THAN:
-						default:
-							if (v < a[idx])
-								tmp->value1++;
-					}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+static void esdm_atomic_max(double *dst, double v)
+{
+	double cur;
+	__atomic_load(dst, &cur, __ATOMIC_RELAXED);
+	while ((cur < v) && !__atomic_compare_exchange(dst, &cur, &v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
 
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, fv = fill_value ? *(short *) fill_value : 0, v = strtol(arg, NULL, 10);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv))
-					switch (thresh_type) {
-						case ESDM_FUNCTION_OP_LESS_THAN:
-							if (v > a[idx])
-								tmp->value1++;
-							break;
-						case ESDM_FUNCTION_OP_MORE_THAN:
-						default:
-							if (v < a[idx])
-								tmp->value1++;
-					}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+static void esdm_atomic_min(double *dst, double v)
+{
+	double cur;
+	__atomic_load(dst, &cur, __ATOMIC_RELAXED);
+	while ((cur > v) && !__atomic_compare_exchange(dst, &cur, &v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
 
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, fv = fill_value ? *(int *) fill_value : 0, v = strtol(arg, NULL, 10);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv))
-					switch (thresh_type) {
-						case ESDM_FUNCTION_OP_LESS_THAN:
-							if (v > a[idx])
-								tmp->value1++;
-							break;
-						case ESDM_FUNCTION_OP_MORE_THAN:
-						default:
-							if (v < a[idx])
-								tmp->value1++;
-					}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Set the accumulators to the identity of the merge: extremes are tracked by sentinels, as the count may be updated concurrently
+static void esdm_stream_shards_reset(esdm_stream_context_t * context)
+{
+	int i, opcode = context->plan.opcode;
+	for (i = 0; i < ESDM_STREAM_SHARD_N; ++i) {
+		esdm_stream_data_out_t *acc = &context->shard[i].acc;
+		memset(acc, 0, sizeof(esdm_stream_data_out_t));
+		acc->value1 = opcode == ESDM_OP_MAX ? -INFINITY : (opcode == ESDM_OP_MIN) || (opcode == ESDM_OP_STAT) ? INFINITY : 0;
+		acc->value2 = opcode == ESDM_OP_STAT ? -INFINITY : 0;
+		context->shard[i].shift = NAN;
+		context->shard[i].sum = 0;
+	}
+}
 
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, fv = fill_value ? *(long long *) fill_value : 0, v = strtoll(arg, NULL, 10);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv))
-					switch (thresh_type) {
-						case ESDM_FUNCTION_OP_LESS_THAN:
-							if (v > a[idx])
-								tmp->value1++;
-							break;
-						case ESDM_FUNCTION_OP_MORE_THAN:
-						default:
-							if (v < a[idx])
-								tmp->value1++;
-					}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Shard used by the current thread, assigned on first use
+static int esdm_stream_shard_index(void)
+{
+	static unsigned int esdm_shard_count = 0;
+	static __thread unsigned int esdm_shard_id = 0;
+	if (!esdm_shard_id)
+		esdm_shard_id = __atomic_add_fetch(&esdm_shard_count, 1, __ATOMIC_RELAXED);
+	return esdm_shard_id % ESDM_STREAM_SHARD_N;
+}
 
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, fv = fill_value ? *(float *) fill_value : 0, v = strtof(arg, NULL);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv))
-					switch (thresh_type) {
-						case ESDM_FUNCTION_OP_LESS_THAN:
-							if (v > a[idx])
-								tmp->value1++;
-							break;
-						case ESDM_FUNCTION_OP_MORE_THAN:
-						default:
-							if (v < a[idx])
-								tmp->value1++;
-					}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Add the moments of a partial result to the sums of the deviations from the shift of a shard and of their squares:
+// they are not affected by cancellation as long as the shift is close to the mean
+// (weight is the number of elements of the partial result, or the sum of their weights)
+static void esdm_stream_shift_atomic(esdm_stream_shard_t * shard, double *sum, double *squares, double weight, double src_sum, double src_m2)
+{
+	double shift, mean, unset = NAN;
+	if (weight == 0)
+		return;
+	mean = src_sum / weight;
+	__atomic_load(&shard->shift, &shift, __ATOMIC_RELAXED);
+	if ((shift != shift) && __atomic_compare_exchange(&shard->shift, &unset, &mean, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		shift = mean;
+	else if (shift != shift)
+		shift = unset;	// Set by another thread in the meantime
+	esdm_atomic_add(sum, src_sum - weight * shift);
+	esdm_atomic_add(squares, src_m2 + weight * (mean - shift) * (mean - shift));
+}
 
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, fv = fill_value ? *(double *) fill_value : 0, v = strtod(arg, NULL);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				if (!fill_value || (a[idx] != fv))
-					switch (thresh_type) {
-						case ESDM_FUNCTION_OP_LESS_THAN:
-							if (v > a[idx])
-								tmp->value1++;
-							break;
-						case ESDM_FUNCTION_OP_MORE_THAN:
-						default:
-							if (v < a[idx])
-								tmp->value1++;
-					}
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
+// Moments of a shard, converted back to sum and M2
+static void esdm_stream_unshift(double shift, double weight, double *sum, double *squares)
+{
+	if (weight == 0)
+		return;
+	*squares -= *sum * *sum / weight;
+	*sum += weight * shift;
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// Lock-free version of esdm_stream_merge, used to merge the partial result of a fragment into a shard
+static void esdm_stream_merge_atomic(const esdm_stream_plan_t * plan, esdm_stream_shard_t * shard, const esdm_stream_data_out_t * src)
+{
+	esdm_stream_data_out_t *dst = &shard->acc;
+	switch (plan->opcode) {
+		case ESDM_OP_MAX:
+			esdm_atomic_max(&dst->value1, src->value1);
+			break;
+		case ESDM_OP_MIN:
+			esdm_atomic_min(&dst->value1, src->value1);
+			break;
+		case ESDM_OP_AVG:
+		case ESDM_OP_SUM:
+		case ESDM_OP_OUTLIER:
+			esdm_atomic_add(&dst->value1, src->value1);
+			break;
+		case ESDM_OP_STD:
+		case ESDM_OP_VAR:
+			esdm_stream_shift_atomic(shard, &dst->value1, &dst->value2, src->number, src->value1, src->value2);
+			break;
+		case ESDM_OP_WSUM:
+		case ESDM_OP_WAVG:
+			esdm_atomic_add(&dst->value1, src->value1);
+			esdm_atomic_add(&dst->value3, src->value3);
+			break;
+		case ESDM_OP_WSTD:
+		case ESDM_OP_WVAR:
+			esdm_stream_shift_atomic(shard, &dst->value1, &dst->value2, src->value3, src->value1, src->value2);
+			esdm_atomic_add(&dst->value3, src->value3);
+			break;
+		case ESDM_OP_STAT:
+			if (src->number) {
+				esdm_atomic_min(&dst->value1, src->value1);
+				esdm_atomic_max(&dst->value2, src->value2);
+			}
+			esdm_stream_shift_atomic(shard, &dst->value3, &dst->value4, src->number, src->value3, src->value4);
+			esdm_atomic_add(&shard->sum, src->value3);
+			__atomic_add_fetch(&dst->missing, src->missing, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&dst->outlier, src->outlier, __ATOMIC_RELAXED);
+			break;
+		default:
+			return;
+	}
+	__atomic_add_fetch(&dst->number, src->number, __ATOMIC_RELAXED);
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_SUM_SCALAR)) {
+#ifdef _OPENMP
+// Process the elements of a fragment from first to last, block by block
+static void esdm_stream_blocks(esdm_stream_kernel_t kernel, const esdm_stream_plan_t * plan, const esdm_fragment_t * f, size_t step, uint64_t first, uint64_t last,
+			       esdm_stream_data_out_t * tmp)
+{
+	uint64_t block = ESDM_PARALLEL_BLOCK_BYTES / step;
+	esdm_fragment_t b = *f;
+	esdm_stream_data_out_t partial;
+
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t));
+	for (; first < last; first += b.n) {
+		b.in = (const char *) f->in + first * step;
+		b.out = (char *) f->out + first * step;
+		b.n = last - first < block ? last - first : block;
+		b.first = f->first + first;
+		kernel(plan, &b, &partial);
+		partial.index += first;	// Positions are relative to the fragment
+		esdm_stream_merge(plan, tmp, &partial);
+	}
+}
+#endif
 
-		if (!args) {
-			// TODO: copy only the data related to the dataspace
-			memcpy(stream_data->buff, buff, esdm_dataspace_total_bytes(space));
-			return NULL;
+// Run a kernel on a fragment, splitting it among several threads in case it is large enough
+static void esdm_stream_run(esdm_stream_kernel_t kernel, const esdm_stream_plan_t * plan, const esdm_fragment_t * f, size_t step, esdm_stream_data_out_t * tmp)
+{
+#ifdef _OPENMP
+	int threads = omp_get_max_threads();
+	if (esdm_parallel_bytes && (f->n * step >= esdm_parallel_bytes) && (threads > 1) && !omp_in_parallel()) {
+		int t;
+		uint64_t chunk = (f->n + threads - 1) / threads;
+		esdm_stream_data_out_t partial[threads];
+#pragma omp parallel for schedule(static) num_threads(threads)
+		for (t = 0; t < threads; ++t) {
+			uint64_t first = t * chunk < f->n ? t * chunk : f->n;
+			esdm_stream_blocks(kernel, plan, f, step, first, first + chunk < f->n ? first + chunk : f->n, partial + t);
 		}
+		// Partial results are merged in order, so that the result does not depend on scheduling
+		*tmp = partial[0];
+		for (t = 1; t < threads; ++t)
+			esdm_stream_merge(plan, tmp, partial + t);
+		return;
+	}
+#else
+	UNUSED(step);
+#endif
+	kernel(plan, f, tmp);
+}
 
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		char *save_pointer = NULL, *arg = args ? strtok_r(args, ESDM_SEPARATOR, &save_pointer) : NULL;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char scalar = arg ? strtol(arg, NULL, 10) : 0;
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] + scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short scalar = arg ? strtol(arg, NULL, 10) : 0;
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] + scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int scalar = arg ? strtol(arg, NULL, 10) : 0;
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] + scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long scalar = arg ? strtoll(arg, NULL, 10) : 0;
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] + scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float scalar = arg ? strtof(arg, NULL) : 0;
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] + scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double scalar = arg ? strtod(arg, NULL) : 0;
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] + scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_MUL_SCALAR)) {
-
-		if (!args) {
-			// TODO: copy only the data related to the dataspace
-			memcpy(stream_data->buff, buff, esdm_dataspace_total_bytes(space));
-			return NULL;
-		}
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		char *save_pointer = NULL, *arg = args ? strtok_r(args, ESDM_SEPARATOR, &save_pointer) : NULL;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char scalar = arg ? strtol(arg, NULL, 10) : 1;
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short scalar = arg ? strtol(arg, NULL, 10) : 1;
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int scalar = arg ? strtol(arg, NULL, 10) : 1;
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long scalar = arg ? strtoll(arg, NULL, 10) : 1;
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float scalar = arg ? strtof(arg, NULL) : 1;
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double scalar = arg ? strtod(arg, NULL) : 1;
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * scalar : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_ABS)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? abs(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? abs(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? abs(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? abs(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? fabs(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? fabs(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_SQRT)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sqrt(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sqrt(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sqrt(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sqrt(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sqrt(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sqrt(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_SQR)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? a[idx] * a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-		// TODO: to be optimized for integer values
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_CEIL)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? ceil(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? ceil(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? ceil(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? ceil(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? ceil(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? ceil(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-		// TODO: to be optimized for integer values
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_FLOOR) || !strcmp(stream_data->operation, ESDM_FUNCTION_INT)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-		// TODO: to be optimized for integer values
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_ROUND) || !strcmp(stream_data->operation, ESDM_FUNCTION_NINT)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx] + 0.5) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx] + 0.5) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx] + 0.5) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx] + 0.5) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx] + 0.5) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? floor(a[idx] + 0.5) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_POW)) {
-
-		if (!args) {
-			// TODO: copy only the data related to the dataspace
-			memcpy(stream_data->buff, buff, esdm_dataspace_total_bytes(space));
-			return NULL;
-		}
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		char *save_pointer = NULL, *arg = args ? strtok_r(args, ESDM_SEPARATOR, &save_pointer) : NULL;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char scalar = arg ? strtol(arg, NULL, 10) : 1;
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? pow(a[idx], scalar) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short scalar = arg ? strtol(arg, NULL, 10) : 1;
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? pow(a[idx], scalar) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int scalar = arg ? strtol(arg, NULL, 10) : 1;
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? pow(a[idx], scalar) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long scalar = arg ? strtoll(arg, NULL, 10) : 1;
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? pow(a[idx], scalar) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float scalar = arg ? strtof(arg, NULL) : 1;
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? pow(a[idx], scalar) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double scalar = arg ? strtod(arg, NULL) : 1;
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? pow(a[idx], scalar) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_EXP)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? exp(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? exp(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? exp(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? exp(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? exp(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? exp(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_LOG)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_LOG10)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log10(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log10(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log10(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log10(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log10(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? log10(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_SIN)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_COS)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
-
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_TAN)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// Kernel of the chains followed by a reduction: the reduction is applied to each block of transformed elements,
+// which is still in the cache, so that the transformed dataset is never written
+static void esdm_stream_fused(const esdm_stream_plan_t * plan, const esdm_fragment_t * f, esdm_stream_data_out_t * tmp)
+{
+	double v[ESDM_CHAIN_BLOCK];	// Large enough for any type
+	esdm_fragment_t b = *f;
+	esdm_stream_data_out_t partial;
+	uint64_t first;
+
+	b.in = v;
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t));
+	for (first = 0; first < f->n; first += b.n) {
+		b.n = f->n - first < ESDM_CHAIN_BLOCK ? f->n - first : ESDM_CHAIN_BLOCK;
+		b.first = f->first + first;
+		f->transform(plan, f, first, v, b.n);
+		f->reduce(plan, &b, &partial);
+		esdm_stream_merge(plan, tmp, &partial);
+	}
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_ASIN)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? asin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? asin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? asin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? asin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? asin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? asin(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+static int esdm_type_index(esdm_type_t type)
+{
+	if (type == SMD_DTYPE_INT8)
+		return ESDM_TYPE_INT8;
+	if (type == SMD_DTYPE_INT16)
+		return ESDM_TYPE_INT16;
+	if (type == SMD_DTYPE_INT32)
+		return ESDM_TYPE_INT32;
+	if (type == SMD_DTYPE_INT64)
+		return ESDM_TYPE_INT64;
+	if (type == SMD_DTYPE_UINT8)
+		return ESDM_TYPE_UINT8;
+	if (type == SMD_DTYPE_UINT16)
+		return ESDM_TYPE_UINT16;
+	if (type == SMD_DTYPE_UINT32)
+		return ESDM_TYPE_UINT32;
+	if (type == SMD_DTYPE_UINT64)
+		return ESDM_TYPE_UINT64;
+	if (type == SMD_DTYPE_FLOAT)
+		return ESDM_TYPE_FLOAT;
+	if (type == SMD_DTYPE_DOUBLE)
+		return ESDM_TYPE_DOUBLE;
+	return -1;
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// Select the kernel variant according to the fill value: a NaN fill value marks NaN elements as missing
+static int esdm_fill_mode(int type, const void *fill_value)
+{
+	if (!fill_value)
+		return ESDM_FILL_NONE;
+	if ((type == ESDM_TYPE_FLOAT) && isnan(*(const float *) fill_value))
+		return ESDM_FILL_NAN;
+	if ((type == ESDM_TYPE_DOUBLE) && isnan(*(const double *) fill_value))
+		return ESDM_FILL_NAN;
+	return ESDM_FILL_VALUE;
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_ACOS)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? acos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? acos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? acos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? acos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? acos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? acos(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+// Convert the position of the extreme in the fragment into global coordinates, following the header of the partial result
+static void esdm_arg_coordinates(esdm_stream_data_out_t * tmp, int64_t ndims, int64_t const *size, int64_t const *offset)
+{
+	int64_t i, *coord = (int64_t *) (tmp + 1);
+	uint64_t index = tmp->index;
+	tmp->dims = ndims;
+	for (i = ndims - 1; i >= 0; --i) {
+		coord[i] = (size && (size[i] > 0) ? (int64_t) (index % size[i]) : 0) + (offset ? offset[i] : 0);
+		index = size && (size[i] > 0) ? index / size[i] : 0;
+	}
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// Locate a fragment of a weighted reduction in the dataspace being read, which has to include it
+static esdm_status esdm_weight_prepare(const esdm_stream_data_t * stream_data, esdm_dataspace_t * space, esdm_fragment_t * f, int64_t * origin)
+{
+	int64_t i;
+	if (!stream_data->space || (esdm_dataspace_get_dims(stream_data->space) != f->ndims) || (f->ndims <= 0) || !f->size)
+		return ESDM_ERROR;
+
+	int64_t const *fo = esdm_dataspace_get_offset(space);
+	int64_t const *qs = esdm_dataspace_get_size(stream_data->space), *qo = esdm_dataspace_get_offset(stream_data->space);
+	if (!fo || !qs || !qo)
+		return ESDM_ERROR;
+
+	for (i = 0; i < f->ndims; ++i) {
+		origin[i] = fo[i] - qo[i];
+		if ((origin[i] < 0) || (origin[i] + f->size[i] > qs[i]))
+			return ESDM_ERROR;
+	}
+	f->origin = origin;
+	f->extent = qs;
+	f->weights = stream_data->weights;
+	f->weight_array = stream_data->weights ? NULL : stream_data->weight_array;
+	if (!f->weights && !f->weight_array) {
+		// Unit weights
+		static const double *const none[ESDM_ARG_DIMS_MAX];
+		if (f->ndims > ESDM_ARG_DIMS_MAX)
+			return ESDM_ERROR;
+		f->weights = none;
+	}
+	return ESDM_SUCCESS;
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_ATAN)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? atan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? atan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? atan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? atan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? atan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? atan(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+static void esdm_stream_pool_release(esdm_stream_pool_t * pool)
+{
+	int i;
+	for (i = 0; i < ESDM_STREAM_POOL_SIZE; ++i) {
+		free(pool->slot[i]);
+		pool->slot[i] = NULL;
+		pool->capacity[i] = 0;
+	}
+	pool->used = 0;
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
+// Get a free slot of the pool with room for a payload of size bytes, falling back to the heap in case all the slots are in use
+static esdm_stream_data_out_t *esdm_stream_pool_get(esdm_stream_pool_t * pool, size_t size)
+{
+	uint64_t used = __atomic_load_n(&pool->used, __ATOMIC_RELAXED);
+	while (~used) {
+		int i = __builtin_ctzll(~used);
+		if (__atomic_compare_exchange_n(&pool->used, &used, used | (1ULL << i), 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			// The slot is owned by this thread until it is put back, but its address is read by esdm_stream_pool_put
+			esdm_stream_data_out_t *slot = __atomic_load_n(&pool->slot[i], __ATOMIC_RELAXED);
+			if (!slot || (pool->capacity[i] < size)) {
+				// Unpublished before being freed, otherwise a buffer allocated by another thread at the same address
+				// could be taken for the slot by esdm_stream_pool_put
+				__atomic_store_n(&pool->slot[i], NULL, __ATOMIC_RELAXED);
+				free(slot);
+				slot = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t) + size);
+				pool->capacity[i] = slot ? size : 0;
+				__atomic_store_n(&pool->slot[i], slot, __ATOMIC_RELAXED);
+			}
+			if (!slot)
+				__atomic_fetch_and(&pool->used, ~(1ULL << i), __ATOMIC_RELEASE);
+			return slot;
 		}
+	}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_SINH)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sinh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sinh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sinh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sinh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sinh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? sinh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+	return (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t) + size);
+}
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
+static void esdm_stream_pool_put(esdm_stream_pool_t * pool, esdm_stream_data_out_t * tmp)
+{
+	int i;
+	if (tmp == &pool->last)
+		return;
+	for (i = 0; i < ESDM_STREAM_POOL_SIZE; ++i)
+		if (__atomic_load_n(&pool->slot[i], __ATOMIC_RELAXED) == tmp) {
+			__atomic_fetch_and(&pool->used, ~(1ULL << i), __ATOMIC_RELEASE);
+			return;
 		}
+	free(tmp);
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_COSH)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cosh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cosh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cosh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cosh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cosh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? cosh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+// Clear a partial result followed by a payload of size bytes (counters, bitmap or registers), where sketches are initialized instead
+static void esdm_stream_payload_init(const esdm_stream_plan_t * plan, esdm_stream_data_out_t * tmp, size_t size)
+{
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t));
+	if (plan->opcode == ESDM_OP_QUANTILE)
+		esdm_sketch_init((esdm_sketch_t *) (tmp + 1), plan->sketch_size);
+	else
+		memset(tmp + 1, 0, size);
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_TANH)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tanh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tanh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tanh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tanh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tanh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? tanh(a[idx]) : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+#ifdef _OPENMP
+// Merge the payload of a partial result into the one of the block preceding it, where size is the size of the type
+static esdm_status esdm_stream_payload_merge(const esdm_stream_plan_t * plan, esdm_stream_data_out_t * dst, const esdm_stream_data_out_t * src, size_t size)
+{
+	uint64_t i, n, *count = (uint64_t *) (dst + 1);
+	const uint64_t *other = (const uint64_t *) (src + 1);
+	uint8_t *reg = (uint8_t *) (dst + 1);
+	const uint8_t *other_reg = (const uint8_t *) (src + 1);
+
+	switch (plan->opcode) {
+		case ESDM_OP_HISTOGRAM:
+			for (i = 0; i < (uint64_t) plan->reduce; ++i)
+				count[i] += other[i];
+			break;
+		case ESDM_OP_PERCENTILE:
+			for (i = 0, n = ((const esdm_percentile_t *) plan->cells)->slots * ESDM_PERCENTILE_BINS; i < n; ++i)
+				count[i] += other[i];
+			dst->number += src->number;
+			break;
+		case ESDM_OP_QUANTILE:
+			if (esdm_sketch_merge((esdm_sketch_t *) (dst + 1), (const esdm_sketch_t *) (src + 1)))
+				return ESDM_ERROR;
+			dst->number = ((const esdm_sketch_t *) (dst + 1))->n;
+			break;
+		case ESDM_OP_COUNT_DISTINCT:
+			if (ESDM_DISTINCT_EXACT(size))
+				for (i = 0, n = ESDM_DISTINCT_WORDS(size); i < n; ++i)
+					count[i] |= other[i];
+			else
+				for (i = 0, n = 1ULL << plan->precision; i < n; ++i)
+					reg[i] = reg[i] < other_reg[i] ? other_reg[i] : reg[i];
+			dst->number += src->number;
+			break;
+		default:
+			break;
+	}
+	return ESDM_SUCCESS;
+}
+#endif
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
+// Run a kernel whose partial result is followed by a payload of size bytes, splitting the fragment among several threads
+// in case it is large enough: each thread fills the payload of its own slot of the pool, then payloads are merged in order
+static void esdm_stream_run_payload(esdm_stream_kernel_t kernel, const esdm_stream_plan_t * plan, esdm_stream_pool_t * pool, const esdm_fragment_t * f, size_t step,
+				    esdm_stream_data_out_t * tmp, size_t size)
+{
+	esdm_stream_payload_init(plan, tmp, size);
+#ifdef _OPENMP
+	int threads = omp_get_max_threads();
+	if (esdm_parallel_bytes && (f->n * step >= esdm_parallel_bytes) && (threads > 1) && !omp_in_parallel()) {
+		int t, done = 1;
+		uint64_t chunk = (f->n + threads - 1) / threads;
+		esdm_stream_data_out_t *partial[threads];
+		partial[0] = tmp;
+		for (t = 1; t < threads; ++t)
+			if ((partial[t] = esdm_stream_pool_get(pool, size)))
+				esdm_stream_payload_init(plan, partial[t], size);
+			else
+				done = 0;
+		if (done) {
+#pragma omp parallel for schedule(static) num_threads(threads)
+			for (t = 0; t < threads; ++t) {
+				esdm_fragment_t b = *f;
+				uint64_t first = t * chunk < f->n ? t * chunk : f->n;
+				b.in = (const char *) f->in + first * step;
+				b.out = (char *) (partial[t] + 1);
+				b.n = (first + chunk < f->n ? first + chunk : f->n) - first;
+				b.first = f->first + first;
+				kernel(plan, &b, partial[t]);
+			}
+			for (t = 1; t < threads; ++t)
+				done &= !esdm_stream_payload_merge(plan, tmp, partial[t], step);
 		}
+		for (t = 1; t < threads; ++t)
+			if (partial[t])
+				esdm_stream_pool_put(pool, partial[t]);
+		if (done)
+			return;
+		// Only sketches may fail to be merged, in which case the fragment is processed again by a single thread
+		esdm_stream_payload_init(plan, tmp, size);
+	}
+#else
+	UNUSED(pool);
+	UNUSED(step);
+#endif
+	kernel(plan, f, tmp);
+}
 
-		// TODO: to be optimized for integer values
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_RECI)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? 1.0 / a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? 1.0 / a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? 1.0 / a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? 1.0 / a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? 1.0 / a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? 1.0 / a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
+// Evaluate the stride in cells of each dimension, 0 for the collapsed ones, and return the number of cells;
+// the cyclic dimension of the output has a cell for each group, while the one of a fragment has a cell for each group
+// its elements fall in, starting from the group of its first element, so that short fragments have few cells
+static int64_t esdm_axis_strides(const esdm_stream_plan_t * plan, int64_t ndims, int64_t const *size, int64_t *stride, int fragment)
+{
+	int64_t i, cells = 1;
+	for (i = ndims - 1; i >= 0; --i)
+		if (plan->period && (i == plan->cyclic)) {
+			stride[i] = cells;
+			cells *= fragment && (size[i] < plan->period) ? size[i] : plan->period;
+		} else if ((i < 64) && (plan->axes & (1ULL << i)))
+			stride[i] = 0;
+		else {
+			stride[i] = cells;
+			cells *= size[i];
 		}
+	return cells;
+}
 
-	} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_NOT)) {
-
-		tmp = (esdm_stream_data_out_t *) malloc(sizeof(esdm_stream_data_out_t));
-		tmp->number = 1;
-
-		if (type == SMD_DTYPE_INT8) {
-
-			char *a = (char *) buff, v = 0, fv = fill_value ? *(char *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? !a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT16) {
-
-			short *a = (short *) buff, v = 0, fv = fill_value ? *(short *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? !a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT32) {
-
-			int *a = (int *) buff, v = 0, fv = fill_value ? *(int *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? !a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_INT64) {
-
-			long long *a = (long long *) buff, v = 0, fv = fill_value ? *(long long *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? !a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_FLOAT) {
-
-			float *a = (float *) buff, v = 0, fv = fill_value ? *(float *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? !a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
-
-		} else if (type == SMD_DTYPE_DOUBLE) {
-
-			double *a = (double *) buff, v = 0, fv = fill_value ? *(double *) fill_value : 0;
-			size_t step = sizeof(v);
-			for (k = 0; k < n; k++) {
-				idx = 0;
-				for (i = 0; i < ndims; i++)
-					idx = idx * s[i] + ci[i];
-				v = !fill_value || (a[idx] != fv) ? !a[idx] : fv;
-				memcpy(stream_data->buff + idx * step, &v, step);
-				for (i = ndims - 1; i > 0; i--) {
-					ci[i]++;
-					if (ci[i] < ei[i])
-						break;
-					ci[i] = 0;	// si[i];
-				}
-				if (!i)
-					ci[i]++;
-			}
-			tmp->value1 = v;
+// Check that the dimensions collapsed or grouped by an axis-wise reduction belong to the dataspace being read
+static esdm_status esdm_axis_check(const esdm_stream_plan_t * plan, esdm_dataspace_t * space)
+{
+	int64_t ndims = esdm_dataspace_get_dims(space);
+	if ((ndims <= 0) || ((ndims < 64) && (plan->axes >> ndims)))
+		return ESDM_ERROR;
 
-		} else {
-			free(tmp);
-			if (args)
-				free(args);
-			return NULL;
-		}
+	return ESDM_SUCCESS;
+}
+
+// Get the output cells of axis-wise and rolling reductions, related to the dataspace being read: they are allocated
+// by esdm_stream_prepare_concurrent in case fragments are merged by several threads, on first use otherwise
+static esdm_axis_cell_t *esdm_axis_cells(esdm_stream_data_t * stream_data)
+{
+	esdm_stream_plan_t *plan = &stream_data->context->plan;
+	if (plan->cells || !stream_data->space)
+		return (esdm_axis_cell_t *) plan->cells;
+
+	int64_t ndims = esdm_dataspace_get_dims(stream_data->space);
+	int64_t const *size = esdm_dataspace_get_size(stream_data->space);
+	if ((ndims <= 0) || !size)
+		return NULL;
+
+	// Rolling reductions have a cell for each element
+	int64_t stride[ndims];
+	if ((plan->opcode >= ESDM_OP_ROLLING_SUM) && (plan->opcode <= ESDM_OP_ROLLING_MAX))
+		plan->cells = calloc(esdm_dataspace_element_count(stream_data->space), sizeof(esdm_axis_cell_t));
+	else
+		plan->cells = calloc(esdm_axis_strides(plan, ndims, size, stride, 0), sizeof(esdm_axis_cell_t));
+	return (esdm_axis_cell_t *) plan->cells;
+}
 
+// Evaluate the result of an output cell of axis-wise reductions
+static double esdm_axis_result(int opcode, const esdm_axis_cell_t * cell)
+{
+	double n = cell->number, result;
+	switch (opcode) {
+		case ESDM_OP_AVG:
+			return cell->value1 / n;
+		case ESDM_OP_STD:
+		case ESDM_OP_VAR:
+			result = n > 1 ? cell->value2 / (n - 1) : 0;
+			return opcode == ESDM_OP_STD ? sqrt(result) : result;
+		default:
+			return cell->value1;
 	}
+}
+
+// Process a fragment of an axis-wise reduction: the partial result is a header followed by the cells of the fragment
+static esdm_stream_data_out_t *esdm_axis_stream(const esdm_stream_plan_t * plan, esdm_stream_pool_t * pool, esdm_dataspace_t * space, const void *buff, const void *fill_value, int type,
+						int mode)
+{
+	esdm_stream_kernel_t kernel = esdm_axis_kernels[plan->opcode][type][mode];
+	int64_t ndims = esdm_dataspace_get_dims(space);
+	int64_t const *size = esdm_dataspace_get_size(space);
+	if (!kernel || (ndims <= 0) || !size)
+		return NULL;
 
-	if (args)
-		free(args);
+	int64_t stride[ndims];
+	int64_t cells = esdm_axis_strides(plan, ndims, size, stride, 1);
+	esdm_stream_data_out_t *tmp = esdm_stream_pool_get(pool, cells * sizeof(esdm_axis_cell_t));
+	if (!tmp)
+		return NULL;
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t) + cells * sizeof(esdm_axis_cell_t));
+	tmp->number = cells;
+
+	esdm_fragment_t fragment;
+	memset(&fragment, 0, sizeof(esdm_fragment_t));
+	fragment.in = buff;
+	fragment.n = esdm_dataspace_element_count(space);
+	fragment.ndims = ndims;
+	fragment.size = size;
+	fragment.fill_value = fill_value;
+	fragment.stride = stride;
+	fragment.cells = (esdm_axis_cell_t *) (tmp + 1);
+	fragment.cyclic = plan->period && (plan->cyclic < ndims) ? plan->cyclic : -1;
+	fragment.period = plan->period;
+	kernel(plan, &fragment, tmp);
 
 	return tmp;
 }
 
-void esdm_reduce_func(esdm_dataspace_t * space, void *user_ptr, void *stream_func_out)
+// Merge the cells of a fragment into the output cells, updating the related values of the output buffer
+static void esdm_axis_reduce(esdm_stream_data_t * stream_data, esdm_dataspace_t * space, int type, const esdm_stream_data_out_t * tmp)
 {
-	esdm_stream_data_out_t *tmp = (esdm_stream_data_out_t *) stream_func_out;
-
-	do {
+	esdm_stream_plan_t *plan = &stream_data->context->plan;
+	int64_t i, k, ndims = esdm_dataspace_get_dims(space);
+	if (!stream_data->space || (esdm_dataspace_get_dims(stream_data->space) != ndims) || (ndims <= 0))
+		return;
+
+	int64_t const *fs = esdm_dataspace_get_size(space), *fo = esdm_dataspace_get_offset(space);
+	int64_t const *qs = esdm_dataspace_get_size(stream_data->space), *qo = esdm_dataspace_get_offset(stream_data->space);
+	if (!fs || !fo || !qs || !qo)
+		return;
+
+	// Groups are evaluated from the global position of the fragment
+	int64_t fstride[ndims], qstride[ndims], ci[ndims], phase = 0;
+	int64_t fcells = esdm_axis_strides(plan, ndims, fs, fstride, 1);
+	esdm_axis_strides(plan, ndims, qs, qstride, 0);
+	if (plan->period && (plan->cyclic < ndims))
+		phase = ((fo[plan->cyclic] + plan->phase) % plan->period + plan->period) % plan->period;
+	if (!esdm_axis_cells(stream_data))
+		return;
+
+	// Cells of different fragments may be related to the same output cell
+	if (plan->concurrent)
+		while (__atomic_test_and_set(&stream_data->context->lock, __ATOMIC_ACQUIRE));
+	const esdm_axis_cell_t *src = (const esdm_axis_cell_t *) (tmp + 1);
+	esdm_axis_cell_t *dst;
+	for (i = 0; i < ndims; ++i)
+		ci[i] = 0;
+	for (k = 0; k < fcells; ++k, ++src) {
+		// Position of the output cell related to the current cell of the fragment: groups are the same,
+		// and they are all in the output also in case the dataspace is shorter than the period
+		int64_t c, g = 0, inside = 1;
+		for (i = 0; i < ndims; ++i)
+			if (fstride[i]) {
+				c = plan->period && (i == plan->cyclic) ? (phase + ci[i]) % plan->period : fo[i] + ci[i] - qo[i];
+				inside &= (c >= 0) && (c < (plan->period && (i == plan->cyclic) ? plan->period : qs[i]));
+				g += c * qstride[i];
+			}
+		if (inside && src->number) {
+			dst = (esdm_axis_cell_t *) plan->cells + g;
+			if ((plan->opcode == ESDM_OP_MAX) || (plan->opcode == ESDM_OP_MIN)) {
+				if (!dst->number || ((plan->opcode == ESDM_OP_MAX) ? dst->value1 < src->value1 : dst->value1 > src->value1))
+					dst->value1 = src->value1;
+				dst->number += src->number;
+			} else if ((plan->opcode == ESDM_OP_STD) || (plan->opcode == ESDM_OP_VAR))
+				esdm_moments_merge(&dst->number, &dst->value1, &dst->value2, src->number, src->value1, src->value2);
+			else {
+				dst->value1 += src->value1;
+				dst->number += src->number;
+			}
+			esdm_axis_store[type] (stream_data->buff, g, esdm_axis_result(plan->opcode, dst));
+		}
+		for (i = ndims - 1; i >= 0; --i)
+			if (fstride[i]) {
+				if (++ci[i] < (plan->period && (i == plan->cyclic) && (fs[i] > plan->period) ? plan->period : fs[i]))
+					break;
+				ci[i] = 0;
+			}
+	}
+	stream_data->valid = 1;
+	if (plan->concurrent)
+		__atomic_clear(&stream_data->context->lock, __ATOMIC_RELEASE);
+}
 
-		if (!space || !user_ptr || (tmp && !tmp->number))
-			break;
+// Process a fragment of a rolling reduction: the partial result is a header followed by the cells of the extended fragment
+// and, in case of extremes, by the deques used by the kernel, so that they are allocated once for each slot of the pool
+static esdm_stream_data_out_t *esdm_rolling_stream(const esdm_stream_plan_t * plan, esdm_stream_pool_t * pool, esdm_dataspace_t * space, const void *buff, const void *fill_value,
+						   int type, int mode)
+{
+	esdm_stream_kernel_t kernel = esdm_rolling_kernels[plan->opcode][type][mode];
+	int64_t i, ndims = esdm_dataspace_get_dims(space);
+	int64_t const *size = esdm_dataspace_get_size(space);
+	if (!kernel || (ndims <= plan->window_dim) || !size)
+		return NULL;
 
-		esdm_type_t type = esdm_dataspace_get_type(space);
-		esdm_stream_data_t *stream_data = (esdm_stream_data_t *) user_ptr;
-		if (!stream_data->operation)
-			break;
+	int64_t cells = 1, inner = 1;
+	for (i = 0; i < ndims; ++i)
+		cells *= i == plan->window_dim ? size[i] + plan->window - 1 : size[i];
+	for (i = plan->window_dim + 1; i < ndims; ++i)
+		inner *= size[i];
+	int64_t deques = 0;
+	if ((plan->opcode == ESDM_OP_ROLLING_MIN) || (plan->opcode == ESDM_OP_ROLLING_MAX)) {
+		// Deques hold at most window positions of the fragment
+		int64_t len = size[plan->window_dim], cap = plan->window < len ? plan->window : len;
+		deques = (2 + cap) * inner;
+	}
+	esdm_stream_data_out_t *tmp = esdm_stream_pool_get(pool, cells * sizeof(esdm_axis_cell_t) + deques * sizeof(int64_t));
+	if (!tmp)
+		return NULL;
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t) + cells * sizeof(esdm_axis_cell_t));
+	tmp->number = cells;
+
+	esdm_fragment_t fragment;
+	memset(&fragment, 0, sizeof(esdm_fragment_t));
+	fragment.in = buff;
+	fragment.n = esdm_dataspace_element_count(space);
+	fragment.ndims = ndims;
+	fragment.size = size;
+	fragment.fill_value = fill_value;
+	fragment.cells = (esdm_axis_cell_t *) (tmp + 1);
+	if (deques)
+		fragment.out = (char *) (fragment.cells + cells);
+	if (fragment.n)
+		kernel(plan, &fragment, tmp);
 
-		if (!strcmp(stream_data->operation, ESDM_FUNCTION_MAX)) {
+	return tmp;
+}
 
-			if (!tmp)
+// Merge the cells of a fragment into the output cells of the dataspace being read, updating the related values of the output buffer
+static void esdm_rolling_reduce(esdm_stream_data_t * stream_data, esdm_dataspace_t * space, int type, const esdm_stream_data_out_t * tmp)
+{
+	esdm_stream_plan_t *plan = &stream_data->context->plan;
+	int64_t i, k, ndims = esdm_dataspace_get_dims(space), d = plan->window_dim;
+	if (!stream_data->space || (esdm_dataspace_get_dims(stream_data->space) != ndims) || (ndims <= d))
+		return;
+
+	int64_t const *fs = esdm_dataspace_get_size(space), *fo = esdm_dataspace_get_offset(space);
+	int64_t const *qs = esdm_dataspace_get_size(stream_data->space), *qo = esdm_dataspace_get_offset(stream_data->space);
+	if (!fs || !fo || !qs || !qo)
+		return;
+
+	int64_t ext[ndims], ci[ndims];
+	if (!esdm_axis_cells(stream_data))
+		return;
+
+	// Windows of different fragments may overlap the same output cell
+	if (plan->concurrent)
+		while (__atomic_test_and_set(&stream_data->context->lock, __ATOMIC_ACQUIRE));
+	for (i = 0; i < ndims; ++i) {
+		ext[i] = i == d ? fs[i] + plan->window - 1 : fs[i];
+		ci[i] = 0;
+	}
+	const esdm_axis_cell_t *src = (const esdm_axis_cell_t *) (tmp + 1);
+	esdm_axis_cell_t *dst;
+	for (k = 0; k < (int64_t) tmp->number; ++k, ++src) {
+		// Position of the output cell related to the current cell of the fragment
+		int64_t c, g = 0, inside = 1;
+		for (i = 0; i < ndims; ++i) {
+			c = fo[i] + ci[i] - qo[i];
+			inside &= (c >= 0) && (c < qs[i]);
+			g = g * qs[i] + c;
+		}
+		if (inside && src->number) {
+			dst = (esdm_axis_cell_t *) plan->cells + g;
+			if ((plan->opcode == ESDM_OP_ROLLING_MAX) || (plan->opcode == ESDM_OP_ROLLING_MIN)) {
+				if (!dst->number || ((plan->opcode == ESDM_OP_ROLLING_MAX) ? dst->value1 < src->value1 : dst->value1 > src->value1))
+					dst->value1 = src->value1;
+			} else
+				dst->value1 += src->value1;
+			dst->number += src->number;
+			esdm_axis_store[type] (stream_data->buff, g, plan->opcode == ESDM_OP_ROLLING_AVG ? dst->value1 / dst->number : dst->value1);
+		}
+		for (i = ndims - 1; i >= 0; --i) {
+			if (++ci[i] < ext[i])
 				break;
+			ci[i] = 0;
+		}
+	}
+	stream_data->valid = 1;
+	if (plan->concurrent)
+		__atomic_clear(&stream_data->context->lock, __ATOMIC_RELEASE);
+}
 
-			if (type == SMD_DTYPE_INT8) {
+// Parse a threshold, optionally preceded by ESDM_FUNCTION_OP_LESS_THAN or ESDM_FUNCTION_OP_MORE_THAN
+static void esdm_parse_threshold(esdm_stream_plan_t * plan, const char *arg)
+{
+	if (arg && !isdigit((unsigned char) arg[0])) {
+		if (arg[0] == ESDM_FUNCTION_OP_LESS_THAN)
+			plan->thresh_type = ESDM_FUNCTION_OP_LESS_THAN;
+		arg++;
+	}
+	if (arg && arg[0] && (arg[0] != ESDM_SEPARATOR[0])) {
+		plan->has_scalar = 1;
+		plan->iscalar = strtoll(arg, NULL, 10);
+		plan->uscalar = strtoull(arg, NULL, 10);
+		plan->dscalar = strtod(arg, NULL);
+	}
+}
 
-				char v = (char) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(char *) stream_data->buff;
-					if (pre < v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+// Position of an operation in the table of the operations, given its name
+static int esdm_operation_index(const char *name, size_t len)
+{
+	int i;
+	for (i = 0; esdm_operations[i].name; ++i)
+		if (!strncmp(name, esdm_operations[i].name, len) && !esdm_operations[i].name[len])
+			return i;
+	return -1;
+}
 
-			} else if (type == SMD_DTYPE_INT16) {
+// Compile a chain of element-wise operations separated by ESDM_FUNCTION_OP_CHAIN, each one optionally followed
+// by ESDM_FUNCTION_OP_ARG and its argument (a scalar, or the expression of ESDM_FUNCTION_EXPR): in case the last operation
+// is a reduction, its name is returned in name, NULL otherwise
+static esdm_status esdm_stream_chain_compile(esdm_stream_plan_t * plan, const char *operation, const char **name)
+{
+	const char *step = operation;
+	int k;
+	*name = NULL;
+	while (step) {
+		const char *next = strchr(step, ESDM_FUNCTION_OP_CHAIN), *arg = strchr(step, ESDM_FUNCTION_OP_ARG);
+		if (arg && next && (arg > next))
+			arg = NULL;
+		size_t len = arg ? (size_t) (arg - step) : next ? (size_t) (next - step) : strlen(step);
+		int i = esdm_operation_index(step, len);
+		if (i < 0)
+			return ESDM_ERROR;
+
+		if ((esdm_operations[i].opcode < ESDM_OP_SUM_SCALAR) || (esdm_operations[i].opcode > ESDM_OP_EXPR)
+		    || (esdm_operations[i].opcode == ESDM_OP_CHAIN)) {
+			// Only the last operation can be a reduction, whose arguments are given separately
+			if (next || arg)
+				return ESDM_ERROR;
+			*name = esdm_operations[i].name;
+			break;
+		}
+		if (plan->chain >= ESDM_CHAIN_MAX)
+			return ESDM_ERROR;
+		for (k = 0; k < plan->chain; ++k)
+			if ((esdm_operations[i].opcode == ESDM_OP_EXPR) && (plan->steps[k].opcode == ESDM_OP_EXPR))
+				return ESDM_ERROR;	// Only one expression can be compiled into the plan
+
+		esdm_stream_step_t *s = plan->steps + plan->chain++;
+		s->opcode = esdm_operations[i].opcode;
+		s->iscalar = (long long) esdm_operations[i].default_scalar;
+		s->uscalar = (unsigned long long) esdm_operations[i].default_scalar;
+		s->dscalar = esdm_operations[i].default_scalar;
+		if (s->opcode == ESDM_OP_EXPR) {
+			char *text = arg ? strndup(arg + 1, next ? (size_t) (next - arg - 1) : strlen(arg + 1)) : NULL;
+			esdm_status status = esdm_expr_compile(&plan->expr, text);
+			free(text);
+			if (status)
+				return ESDM_ERROR;
+		} else if (arg) {
+			s->iscalar = strtoll(arg + 1, NULL, 10);
+			s->uscalar = strtoull(arg + 1, NULL, 10);
+			s->dscalar = strtod(arg + 1, NULL);
+		}
+		step = next ? next + 1 : NULL;
+	}
 
-				short v = (short) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(short *) stream_data->buff;
-					if (pre < v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	return ESDM_SUCCESS;
+}
 
-			} else if (type == SMD_DTYPE_INT32) {
+esdm_status esdm_stream_plan_compile(esdm_stream_plan_t * plan, const char *operation, const char *args)
+{
+	if (!plan)
+		return ESDM_ERROR;
 
-				int v = (int) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(int *) stream_data->buff;
-					if (pre < v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	memset(plan, 0, sizeof(esdm_stream_plan_t));
+	plan->opcode = ESDM_OP_N;
+	if (!operation)
+		return ESDM_ERROR;
+
+	const char *name = operation;
+	if (strchr(operation, ESDM_FUNCTION_OP_CHAIN) || strchr(operation, ESDM_FUNCTION_OP_ARG)) {
+		if (esdm_stream_chain_compile(plan, operation, &name))
+			return ESDM_ERROR;
+		if (!name) {
+			plan->operation = operation;
+			plan->args = args;
+			plan->opcode = ESDM_OP_CHAIN;
+			return ESDM_SUCCESS;
+		}
+	}
 
-			} else if (type == SMD_DTYPE_INT64) {
+	int i = esdm_operation_index(name, strlen(name));
+	if (i < 0)
+		return ESDM_ERROR;
+
+	plan->operation = operation;
+	plan->args = args;
+	plan->opcode = esdm_operations[i].opcode;
+	plan->thresh_type = ESDM_FUNCTION_OP_MORE_THAN;
+	plan->iscalar = (long long) esdm_operations[i].default_scalar;
+	plan->uscalar = (unsigned long long) esdm_operations[i].default_scalar;
+	plan->dscalar = esdm_operations[i].default_scalar;
+
+	// Only the first argument is considered
+	const char *arg = args ? args + strspn(args, ESDM_SEPARATOR) : NULL;
+	if (arg && !arg[0])
+		arg = NULL;
+
+	switch (plan->opcode) {
+		case ESDM_OP_MAX:
+		case ESDM_OP_MIN:
+		case ESDM_OP_AVG:
+		case ESDM_OP_SUM:
+		case ESDM_OP_STD:
+		case ESDM_OP_VAR:
+			plan->reduce = 1;
+			// Dimensions to be collapsed by axis-wise reductions, or grouped by cyclic index in case of ESDM_FUNCTION_OP_CYCLE
+			while (arg && isdigit((unsigned char) arg[0])) {
+				char *end = NULL;
+				long dim = strtol(arg, &end, 10);
+				if (dim >= 64)
+					return ESDM_ERROR;
+				plan->axes |= 1ULL << dim;
+				if (end[0] == ESDM_FUNCTION_OP_CYCLE) {
+					long long period = strtoll(end + 1, &end, 10), phase = 0;
+					if ((end[0] == '+') || (end[0] == '-'))
+						phase = strtoll(end, &end, 10);
+					if (period <= 0)
+						return ESDM_ERROR;
+					plan->cyclic = (int) dim;
+					plan->period = period;
+					plan->phase = phase;
+				}
+				arg = end + strspn(end, ESDM_SEPARATOR);
+			}
+			break;
+		case ESDM_OP_STAT:
+			for (i = 0; i < ESDM_STAT_N; ++i)
+				if (args && args[i] && (args[i] != ESDM_SEPARATOR[0])) {
+					if (args[i] == ESDM_FUNCTION_OP_SET) {
+						plan->option |= ESDM_STAT_BIT(i);
+						plan->reduce++;
+					}
+				} else
+					break;
+			// The threshold used to count outliers follows the mask
+			if (args && strchr(args, ESDM_SEPARATOR[0]))
+				esdm_parse_threshold(plan, strchr(args, ESDM_SEPARATOR[0]) + 1);
+			break;
+		case ESDM_OP_OUTLIER:
+			plan->reduce = 1;
+			esdm_parse_threshold(plan, arg);
+			break;
+		case ESDM_OP_HISTOGRAM:
+			if (arg && (arg[0] == ESDM_FUNCTION_OP_EDGES)) {
+				// Bin edges, in increasing order
+				for (++arg, i = 0; arg && arg[0] && (i < ESDM_HISTOGRAM_EDGES_MAX); ++i) {
+					char *end = NULL;
+					plan->edges[i] = strtod(arg, &end);
+					if ((end == arg) || (i && !(plan->edges[i] > plan->edges[i - 1])))
+						return ESDM_ERROR;
+					arg = end + strspn(end, ESDM_SEPARATOR);
+				}
+				if (arg && arg[0])
+					return ESDM_ERROR;	// Too many edges
+				plan->bins = i - 1;
+			} else if (arg) {
+				// Number of bins, as many as the edges could define, and bounds of the range
+				char *end = NULL;
+				long bins = strtol(arg, &end, 10);
+				if ((end == arg) || (bins > ESDM_HISTOGRAM_EDGES_MAX - 1))
+					return ESDM_ERROR;
+				plan->uniform = 1;
+				plan->bins = (int) bins;
+				plan->edges[0] = strtod(end + strspn(end, ESDM_SEPARATOR), &end);
+				plan->edges[1] = strtod(end + strspn(end, ESDM_SEPARATOR), &end);
+				if (!(plan->edges[1] > plan->edges[0]))
+					return ESDM_ERROR;
+			}
+			if (plan->bins <= 0)
+				return ESDM_ERROR;
+			plan->reduce = plan->bins + 3;
+			break;
+		case ESDM_OP_QUANTILE:
+			// Probabilities of the quantiles, optionally followed by the size of the sketch
+			plan->sketch_size = ESDM_SKETCH_SIZE_DEFAULT;
+			while (arg && arg[0] && (arg[0] != ESDM_FUNCTION_OP_SKETCH)) {
+				char *end = NULL;
+				if (plan->reduce >= ESDM_QUANTILES_MAX)
+					return ESDM_ERROR;
+				plan->quantiles[plan->reduce] = strtod(arg, &end);
+				if ((end == arg) || !(plan->quantiles[plan->reduce] >= 0) || (plan->quantiles[plan->reduce] > 1))
+					return ESDM_ERROR;
+				plan->reduce++;
+				arg = end + strspn(end, ESDM_SEPARATOR);
+			}
+			if (arg && (arg[0] == ESDM_FUNCTION_OP_SKETCH))
+				plan->sketch_size = (int) strtol(arg + 1, NULL, 10);
+			if ((plan->sketch_size < 2) || (plan->sketch_size > INT_MAX / 8))
+				return ESDM_ERROR;
+			if (!plan->reduce)
+				plan->quantiles[plan->reduce++] = 0.5;	// Median
+			break;
+		case ESDM_OP_ROLLING_SUM:
+		case ESDM_OP_ROLLING_AVG:
+		case ESDM_OP_ROLLING_MIN:
+		case ESDM_OP_ROLLING_MAX:
+			// Length of the window, optionally followed by the dimension along which it slides (the first one by default)
+			plan->reduce = 1;
+			plan->window = arg ? strtoll(arg, NULL, 10) : 0;
+			if (plan->window <= 0)
+				return ESDM_ERROR;
+			arg += strcspn(arg, ESDM_SEPARATOR);
+			arg += strspn(arg, ESDM_SEPARATOR);
+			if (isdigit((unsigned char) arg[0]))
+				plan->window_dim = (int) strtol(arg, NULL, 10);
+			break;
+		case ESDM_OP_ARGMAX:
+		case ESDM_OP_ARGMIN:
+		case ESDM_OP_WSUM:
+		case ESDM_OP_WAVG:
+		case ESDM_OP_WSTD:
+		case ESDM_OP_WVAR:
+			plan->reduce = 1;
+			break;
+		case ESDM_OP_COUNT_DISTINCT:
+			// Precision of the sketch, not used by 8 and 16-bit types
+			plan->reduce = 1;
+			plan->precision = arg ? (int) strtol(arg, NULL, 10) : ESDM_DISTINCT_PRECISION_DEFAULT;
+			if ((plan->precision < ESDM_DISTINCT_PRECISION_MIN) || (plan->precision > ESDM_DISTINCT_PRECISION_MAX))
+				return ESDM_ERROR;
+			break;
+		case ESDM_OP_PERCENTILE:
+			// Percentages in [0, 100]
+			while (arg && arg[0]) {
+				char *end = NULL;
+				if (plan->reduce >= ESDM_QUANTILES_MAX)
+					return ESDM_ERROR;
+				plan->quantiles[plan->reduce] = strtod(arg, &end) / 100;
+				if ((end == arg) || !(plan->quantiles[plan->reduce] >= 0) || (plan->quantiles[plan->reduce] > 1))
+					return ESDM_ERROR;
+				plan->reduce++;
+				arg = end + strspn(end, ESDM_SEPARATOR);
+			}
+			if (!plan->reduce)
+				plan->quantiles[plan->reduce++] = 0.5;	// Median
+			break;
+		case ESDM_OP_EXPR:
+			// The whole argument is the expression, as it may include separators
+			if (esdm_expr_compile(&plan->expr, args))
+				return ESDM_ERROR;
+			break;
+		case ESDM_OP_SUM_SCALAR:
+		case ESDM_OP_MUL_SCALAR:
+		case ESDM_OP_POW:
+			if (!args)	// Data are simply copied in case arguments are not given
+				plan->opcode = ESDM_OP_NOP;
+			else if (arg) {
+				plan->has_scalar = 1;
+				plan->iscalar = strtoll(arg, NULL, 10);
+				plan->uscalar = strtoull(arg, NULL, 10);
+				plan->dscalar = strtod(arg, NULL);
+			}
+			break;
+		default:
+			break;
+	}
 
-				long long v = (long long) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(long long *) stream_data->buff;
-					if (pre < v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	// Element-wise operations can precede only the reductions of the whole dataspace, whose partial results do not depend
+	// on the position of the elements
+	if (plan->chain && (plan->axes || ((plan->opcode != ESDM_OP_MAX) && (plan->opcode != ESDM_OP_MIN) && (plan->opcode != ESDM_OP_AVG)
+					   && (plan->opcode != ESDM_OP_SUM) && (plan->opcode != ESDM_OP_STD) && (plan->opcode != ESDM_OP_VAR)
+					   && (plan->opcode != ESDM_OP_STAT) && (plan->opcode != ESDM_OP_OUTLIER))))
+		return ESDM_ERROR;
 
-			} else if (type == SMD_DTYPE_FLOAT) {
+	return ESDM_SUCCESS;
+}
 
-				float v = (float) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(float *) stream_data->buff;
-					if (pre < v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+// Check whether two strings are equal, where NULL is equal only to NULL
+static int esdm_string_equal(const char *a, const char *b)
+{
+	return a && b ? !strcmp(a, b) : a == b;
+}
 
-			} else if (type == SMD_DTYPE_DOUBLE) {
+esdm_status esdm_stream_prepare(esdm_stream_data_t * stream_data)
+{
+	if (!stream_data)
+		return ESDM_ERROR;
+
+	// Strings are compared rather than their addresses, as the caller may reuse the same buffers for another operation
+	esdm_stream_context_t *context = stream_data->context;
+	esdm_stream_plan_t *plan = context ? &context->plan : NULL;
+	if (plan && (plan->opcode >= 0) && (plan->opcode < ESDM_OP_N) && esdm_string_equal(context->operation, stream_data->operation)
+	    && esdm_string_equal(context->args, stream_data->args))
+		return ESDM_SUCCESS;	// Already compiled
+
+	if (!context) {
+		// Shards are aligned to a cache line
+		if (posix_memalign((void **) &context, 64, sizeof(esdm_stream_context_t)))
+			return ESDM_ERROR;
+		memset(context, 0, sizeof(esdm_stream_context_t));
+		stream_data->context = context;
+		plan = &context->plan;
+	}
 
-				double v = (double) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(double *) stream_data->buff;
-					if (pre < v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	// Accumulators of the previous plan are released before it is overwritten
+	free(plan->cells);
+	plan->cells = NULL;
+	free(context->operation);
+	free(context->args);
+	context->operation = stream_data->operation ? strdup(stream_data->operation) : NULL;
+	context->args = stream_data->args ? strdup(stream_data->args) : NULL;
+	if ((stream_data->operation && !context->operation) || (stream_data->args && !context->args)) {
+		plan->opcode = ESDM_OP_N;
+		return ESDM_ERROR;
+	}
 
-			}
+	// Slots sized for the previous plan are released, as no partial result is pending before the first fragment is processed
+	esdm_stream_pool_release(&context->pool);
 
-		} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_MIN)) {
+	if (esdm_stream_plan_compile(plan, context->operation, context->args)) {
+		plan->opcode = ESDM_OP_N;	// Not to be taken as compiled by the next call
+		return ESDM_ERROR;
+	}
+	esdm_stream_shards_reset(context);
+	context->failed = 0;
 
-			if (!tmp)
-				break;
+	// Dimensions given to axis-wise reductions are checked as soon as the dataspace is known, otherwise by esdm_stream_func
+	if (plan->axes && stream_data->space && esdm_axis_check(plan, stream_data->space)) {
+		plan->opcode = ESDM_OP_N;
+		return ESDM_ERROR;
+	}
 
-			if (type == SMD_DTYPE_INT8) {
+	// The state of exact percentiles is read by the stream kernels, so it has to be ready before the first fragment
+	if ((plan->opcode == ESDM_OP_PERCENTILE) && !esdm_stream_accumulator(plan)) {
+		plan->opcode = ESDM_OP_N;
+		return ESDM_ERROR;
+	}
 
-				char v = (char) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(char *) stream_data->buff;
-					if (pre > v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	return ESDM_SUCCESS;
+}
 
-			} else if (type == SMD_DTYPE_INT16) {
+// To be called before streaming in case esdm_reduce_func is called by several threads concurrently
+esdm_status esdm_stream_prepare_concurrent(esdm_stream_data_t * stream_data)
+{
+	if (esdm_stream_prepare(stream_data))
+		return ESDM_ERROR;
 
-				short v = (short) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(short *) stream_data->buff;
-					if (pre > v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	esdm_stream_plan_t *plan = &stream_data->context->plan;
+	plan->concurrent = 1;
+	if (((plan->opcode == ESDM_OP_HISTOGRAM) || (plan->opcode == ESDM_OP_QUANTILE) || (plan->opcode == ESDM_OP_ARGMAX)
+	     || (plan->opcode == ESDM_OP_ARGMIN) || (plan->opcode == ESDM_OP_COUNT_DISTINCT)) && !esdm_stream_accumulator(plan))
+		return ESDM_ERROR;
 
-			} else if (type == SMD_DTYPE_INT32) {
+	// Output cells of axis-wise and rolling reductions are shared by the threads, so the dataspace being read has to be given
+	if ((plan->axes || ((plan->opcode >= ESDM_OP_ROLLING_SUM) && (plan->opcode <= ESDM_OP_ROLLING_MAX))) && !esdm_axis_cells(stream_data))
+		return ESDM_ERROR;
 
-				int v = (int) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(int *) stream_data->buff;
-					if (pre > v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	return ESDM_SUCCESS;
+}
 
-			} else if (type == SMD_DTYPE_INT64) {
+void esdm_stream_release(esdm_stream_data_t * stream_data)
+{
+	if (!stream_data || !stream_data->context)
+		return;
+
+	esdm_stream_pool_release(&stream_data->context->pool);
+	free(stream_data->context->plan.cells);
+	free(stream_data->context->operation);
+	free(stream_data->context->args);
+	free(stream_data->context);
+	stream_data->context = NULL;
+}
 
-				long long v = (long long) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(long long *) stream_data->buff;
-					if (pre > v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+int esdm_is_a_reduce_func(const char *operation, const char *args)
+{
+	esdm_stream_plan_t plan;
+	if (esdm_stream_plan_compile(&plan, operation, args))
+		return 0;
 
-			} else if (type == SMD_DTYPE_FLOAT) {
+	return plan.reduce;
+}
 
-				float v = (float) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(float *) stream_data->buff;
-					if (pre > v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+// Hand over a fragment transformed in place, so that no output buffer as large as the dataspace is needed
+static void esdm_stream_deliver(esdm_stream_data_t * stream_data, esdm_dataspace_t * space, void *buff)
+{
+	if (stream_data->deliver)
+		stream_data->deliver(space, buff, stream_data->deliver_ptr);
+}
 
-			} else if (type == SMD_DTYPE_DOUBLE) {
+void *esdm_stream_func(esdm_dataspace_t * space, void *buff, void *user_ptr, void *esdm_fill_value)
+{
+	UNUSED(esdm_fill_value);
 
-				double v = (double) tmp->value1, pre;
-				if (stream_data->valid) {
-					pre = *(double *) stream_data->buff;
-					if (pre > v)
-						memcpy(stream_data->buff, &v, sizeof(v));
-				} else {
-					memcpy(stream_data->buff, &v, sizeof(v));
-					stream_data->valid = 1;
-				}
+	if (!space || !buff || !user_ptr)
+		return NULL;
 
-			}
+	esdm_stream_data_t *stream_data = (esdm_stream_data_t *) user_ptr;
+	if (esdm_stream_prepare(stream_data))
+		return NULL;
 
-		} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_AVG) || !strcmp(stream_data->operation, ESDM_FUNCTION_SUM) || !strcmp(stream_data->operation, ESDM_FUNCTION_OUTLIER)) {
+	esdm_stream_plan_t *plan = &stream_data->context->plan;
+	if (plan->opcode == ESDM_OP_NOP) {
+		if (stream_data->in_place)
+			esdm_stream_deliver(stream_data, space, buff);
+		else		// TODO: copy only the data related to the dataspace
+			memcpy(stream_data->buff, buff, esdm_dataspace_total_bytes(space));
+		return NULL;
+	}
 
-			if (!tmp)
-				break;
+	int type = esdm_type_index(esdm_dataspace_get_type(space));
+	if (type < 0)
+		return NULL;
 
-			if (!stream_data->valid) {
-				stream_data->valid = 1;
-				stream_data->value1 = 0;
-				stream_data->number = 0;
-			}
-			stream_data->value1 += tmp->value1;
-			if (!strcmp(stream_data->operation, ESDM_FUNCTION_AVG))
-				stream_data->number += tmp->number;
-			else
-				stream_data->number = 1;
+	int mode = esdm_fill_mode(type, stream_data->fill_value);
+	if ((plan->opcode >= ESDM_OP_ROLLING_SUM) && (plan->opcode <= ESDM_OP_ROLLING_MAX))
+		return esdm_rolling_stream(plan, &stream_data->context->pool, space, buff, stream_data->fill_value, type, mode);
 
-			if (type == SMD_DTYPE_INT8) {
+	esdm_stream_kernel_t kernel = esdm_stream_kernels[plan->opcode][type][mode];
+	if (!kernel)
+		return NULL;
 
-				char v = (char) (stream_data->value1 / stream_data->number);
-				memcpy(stream_data->buff, &v, sizeof(v));
+	if (plan->axes)
+		return esdm_axis_check(plan, space) ? NULL : esdm_axis_stream(plan, &stream_data->context->pool, space, buff, stream_data->fill_value, type, mode);
+
+	esdm_fragment_t fragment;
+	memset(&fragment, 0, sizeof(esdm_fragment_t));
+	fragment.in = buff;
+	fragment.out = stream_data->in_place && !plan->reduce ? buff : stream_data->buff;
+	fragment.n = esdm_dataspace_element_count(space);
+	fragment.ndims = esdm_dataspace_get_dims(space);
+	fragment.size = esdm_dataspace_get_size(space);
+	fragment.fill_value = stream_data->fill_value;
+	if (esdm_simd_kernels && esdm_simd_kernels[plan->opcode][type][mode])
+		kernel = esdm_simd_kernels[plan->opcode][type][mode];
+
+	if (plan->chain && (plan->opcode != ESDM_OP_CHAIN)) {
+		// Blocks of transformed elements are reduced by the vectorized kernels as well
+		fragment.reduce = esdm_simd_kernels && esdm_simd_kernels[plan->opcode][type][mode] ? esdm_simd_kernels[plan->opcode][type][mode] : kernel;
+		fragment.transform = esdm_chain_transforms[type][mode];
+		kernel = esdm_stream_fused;
+	}
 
-			} else if (type == SMD_DTYPE_INT16) {
+	int64_t origin[fragment.ndims > 0 ? fragment.ndims : 1];
+	if ((plan->opcode >= ESDM_OP_WSUM) && (plan->opcode <= ESDM_OP_WVAR) && esdm_weight_prepare(stream_data, space, &fragment, origin))
+		return NULL;
 
-				short v = (short) (stream_data->value1 / stream_data->number);
-				memcpy(stream_data->buff, &v, sizeof(v));
+	if (plan->opcode == ESDM_OP_HISTOGRAM) {
+		// Counters follow the header of the partial result, whose size depends on the number of bins
+		esdm_stream_data_out_t *tmp = esdm_stream_pool_get(&stream_data->context->pool, plan->reduce * sizeof(uint64_t));
+		if (!tmp)
+			return NULL;
+		fragment.out = (char *) (tmp + 1);
+		esdm_stream_run_payload(kernel, plan, &stream_data->context->pool, &fragment, esdm_type_sizes[type], tmp, plan->reduce * sizeof(uint64_t));
+		tmp->number = plan->reduce;
+		return tmp;
+	}
 
-			} else if (type == SMD_DTYPE_INT32) {
+	if (plan->opcode == ESDM_OP_PERCENTILE) {
+		// Histograms of the groups of the current pass follow the header of the partial result
+		size_t bytes = ((const esdm_percentile_t *) plan->cells)->slots * ESDM_PERCENTILE_BINS * sizeof(uint64_t);
+		esdm_stream_data_out_t *tmp = esdm_stream_pool_get(&stream_data->context->pool, bytes);
+		if (!tmp)
+			return NULL;
+		fragment.out = (char *) (tmp + 1);
+		esdm_stream_run_payload(kernel, plan, &stream_data->context->pool, &fragment, esdm_type_sizes[type], tmp, bytes);
+		return tmp;
+	}
 
-				int v = (int) (stream_data->value1 / stream_data->number);
-				memcpy(stream_data->buff, &v, sizeof(v));
+	if (plan->opcode == ESDM_OP_COUNT_DISTINCT) {
+		// The bitmap or the registers of the sketch follow the header of the partial result
+		size_t bytes = ESDM_DISTINCT_EXACT(esdm_type_sizes[type]) ? ESDM_DISTINCT_WORDS(esdm_type_sizes[type]) * sizeof(uint64_t) : 1ULL << plan->precision;
+		esdm_stream_data_out_t *tmp = esdm_stream_pool_get(&stream_data->context->pool, bytes);
+		if (!tmp)
+			return NULL;
+		fragment.out = (char *) (tmp + 1);
+		esdm_stream_run_payload(kernel, plan, &stream_data->context->pool, &fragment, esdm_type_sizes[type], tmp, bytes);
+		return tmp;
+	}
 
-			} else if (type == SMD_DTYPE_INT64) {
+	if (plan->opcode == ESDM_OP_QUANTILE) {
+		// The sketch follows the header of the partial result
+		size_t bytes = esdm_sketch_bytes(plan->sketch_size);
+		esdm_stream_data_out_t *tmp = esdm_stream_pool_get(&stream_data->context->pool, bytes);
+		if (!tmp)
+			return NULL;
+		fragment.out = (char *) (tmp + 1);
+		esdm_stream_run_payload(kernel, plan, &stream_data->context->pool, &fragment, esdm_type_sizes[type], tmp, bytes);
+		return tmp;
+	}
 
-				long long v = (long long) (stream_data->value1 / stream_data->number);
-				memcpy(stream_data->buff, &v, sizeof(v));
+	if ((plan->opcode == ESDM_OP_ARGMAX) || (plan->opcode == ESDM_OP_ARGMIN)) {
+		// Global coordinates of the extreme follow the header of the partial result
+		if ((fragment.ndims < 0) || (fragment.ndims > ESDM_ARG_DIMS_MAX))
+			return NULL;
+		esdm_stream_data_out_t *tmp = esdm_stream_pool_get(&stream_data->context->pool, fragment.ndims * sizeof(int64_t));
+		if (!tmp)
+			return NULL;
+		memset(tmp, 0, sizeof(esdm_stream_data_out_t) + fragment.ndims * sizeof(int64_t));
+		esdm_stream_run(kernel, plan, &fragment, esdm_type_sizes[type], tmp);
+		esdm_arg_coordinates(tmp, fragment.ndims, fragment.size, esdm_dataspace_get_offset(space));
+		return tmp;
+	}
 
-			} else if (type == SMD_DTYPE_FLOAT) {
+	esdm_stream_data_out_t *tmp = plan->reduce ? esdm_stream_pool_get(&stream_data->context->pool, 0) : &stream_data->context->pool.last;
+	if (!tmp)
+		return NULL;
+	esdm_stream_run(kernel, plan, &fragment, esdm_type_sizes[type], tmp);
+	if (stream_data->in_place && !plan->reduce)
+		esdm_stream_deliver(stream_data, space, buff);
 
-				float v = (float) (stream_data->value1 / stream_data->number);
-				memcpy(stream_data->buff, &v, sizeof(v));
+	return tmp;
+}
 
-			} else if (type == SMD_DTYPE_DOUBLE) {
+void esdm_reduce_func(esdm_dataspace_t * space, void *user_ptr, void *stream_func_out)
+{
+	esdm_stream_data_out_t *tmp = (esdm_stream_data_out_t *) stream_func_out;
+	esdm_stream_data_t *stream_data = (esdm_stream_data_t *) user_ptr;
 
-				double v = (double) (stream_data->value1 / stream_data->number);
-				memcpy(stream_data->buff, &v, sizeof(v));
+	do {
 
-			}
+		if (!space || !stream_data || !tmp)
+			break;
 
-		} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_STD) || !strcmp(stream_data->operation, ESDM_FUNCTION_VAR)) {
+		if (esdm_stream_prepare(stream_data))
+			break;
 
-			if (!tmp)
-				break;
+		esdm_stream_context_t *context = stream_data->context;
+		esdm_stream_plan_t *plan = &context->plan;
+		if (esdm_stream_is_empty(plan, tmp))
+			break;
 
-			if (!stream_data->valid) {
-				stream_data->valid = 1;
-				stream_data->value1 = 0;
-				stream_data->value2 = 0;
-				stream_data->number = 0;
-			}
-			stream_data->value1 += tmp->value1;
-			stream_data->value2 += tmp->value2;
-			stream_data->number += tmp->number;
+		if ((plan->opcode >= ESDM_OP_ROLLING_SUM) && (plan->opcode <= ESDM_OP_ROLLING_MAX)) {
+			int type = esdm_type_index(esdm_dataspace_get_type(space));
+			if (type >= 0)
+				esdm_rolling_reduce(stream_data, space, type, tmp);
+			break;
+		}
 
-			double result = (stream_data->value2 - stream_data->value1 * stream_data->value1 / stream_data->number) / stream_data->number;
-			if (stream_data->number > 1)
-				result *= stream_data->number / (stream_data->number - 1.0);
-			if (!strcmp(stream_data->operation, ESDM_FUNCTION_STD))
-				result = sqrt(result);
+		if (plan->axes) {
+			int type = esdm_type_index(esdm_dataspace_get_type(space));
+			if (type >= 0)
+				esdm_axis_reduce(stream_data, space, type, tmp);
+			break;
+		}
 
-			if (type == SMD_DTYPE_INT8) {
+		if (plan->concurrent && (plan->opcode == ESDM_OP_HISTOGRAM)) {
+			int i;
+			for (i = 0; i < plan->reduce; ++i)
+				__atomic_add_fetch((uint64_t *) plan->cells + i, ((const uint64_t *) (tmp + 1))[i], __ATOMIC_RELAXED);
+			break;
+		}
 
-				char v = (char) result;
-				memcpy(stream_data->buff, &v, sizeof(v));
+		if (plan->concurrent && (plan->opcode == ESDM_OP_PERCENTILE)) {
+			esdm_percentile_merge((esdm_percentile_t *) plan->cells, tmp, 1);
+			break;
+		}
 
-			} else if (type == SMD_DTYPE_INT16) {
+		if (plan->concurrent && (plan->opcode == ESDM_OP_QUANTILE)) {
+			// Sketches cannot be merged by atomic operations
+			esdm_sketch_t *sketch = (esdm_sketch_t *) plan->cells;
+			while (__atomic_test_and_set(&sketch->lock, __ATOMIC_ACQUIRE));
+			if (esdm_sketch_merge(sketch, (const esdm_sketch_t *) (tmp + 1)))
+				__atomic_store_n(&context->failed, 1, __ATOMIC_RELAXED);
+			__atomic_clear(&sketch->lock, __ATOMIC_RELEASE);
+			break;
+		}
 
-				short v = (short) result;
-				memcpy(stream_data->buff, &v, sizeof(v));
+		if (plan->concurrent && (plan->opcode == ESDM_OP_COUNT_DISTINCT)) {
+			int type = esdm_type_index(esdm_dataspace_get_type(space));
+			if (type >= 0)
+				esdm_distinct_merge(plan, (esdm_distinct_t *) plan->cells, tmp, esdm_type_sizes[type]);
+			break;
+		}
 
-			} else if (type == SMD_DTYPE_INT32) {
+		if (plan->concurrent && ((plan->opcode == ESDM_OP_ARGMAX) || (plan->opcode == ESDM_OP_ARGMIN))) {
+			// The value and the coordinates of the extreme cannot be updated together by atomic operations
+			esdm_arg_t *acc = (esdm_arg_t *) plan->cells;
+			while (__atomic_test_and_set(&acc->lock, __ATOMIC_ACQUIRE));
+			esdm_arg_merge(plan->opcode, acc, tmp);
+			__atomic_clear(&acc->lock, __ATOMIC_RELEASE);
+			break;
+		}
 
-				int v = (int) result;
-				memcpy(stream_data->buff, &v, sizeof(v));
+		if (plan->concurrent) {
+			esdm_stream_merge_atomic(plan, &context->shard[esdm_stream_shard_index()], tmp);
+			break;
+		}
 
-			} else if (type == SMD_DTYPE_INT64) {
+		int type = esdm_type_index(esdm_dataspace_get_type(space));
+		esdm_reduce_kernel_t kernel = type < 0 ? NULL : esdm_reduce_kernels[plan->opcode][type];
+		if (kernel)
+			kernel(stream_data, tmp);
 
-				long long v = (long long) result;
-				memcpy(stream_data->buff, &v, sizeof(v));
+	} while (0);
 
-			} else if (type == SMD_DTYPE_FLOAT) {
+	if (!tmp)
+		return;
+	if (stream_data && stream_data->context)
+		esdm_stream_pool_put(&stream_data->context->pool, tmp);
+	else
+		free(tmp);
+}
 
-				float v = (float) result;
-				memcpy(stream_data->buff, &v, sizeof(v));
+esdm_status esdm_reduce_finalize(esdm_dataspace_t * space, void *user_ptr)
+{
+	esdm_stream_data_t *stream_data = (esdm_stream_data_t *) user_ptr;
+	if (!space || !stream_data || esdm_stream_prepare(stream_data))
+		return ESDM_ERROR;
+
+	// Exact percentiles are written by esdm_stream_next_pass, while the output cells of axis-wise and rolling reductions
+	// are written into the output buffer while merging, as in the serial case
+	esdm_stream_context_t *context = stream_data->context;
+	esdm_stream_plan_t *plan = &context->plan;
+	if (!plan->concurrent || !plan->reduce || (plan->opcode == ESDM_OP_PERCENTILE) || plan->axes
+	    || ((plan->opcode >= ESDM_OP_ROLLING_SUM) && (plan->opcode <= ESDM_OP_ROLLING_MAX)))
+		return ESDM_SUCCESS;
+
+	// Partial results that could not be merged are reported once
+	if (__atomic_exchange_n(&context->failed, 0, __ATOMIC_ACQUIRE)) {
+		esdm_stream_shards_reset(context);
+		return ESDM_ERROR;
+	}
 
-			} else if (type == SMD_DTYPE_DOUBLE) {
+	int type = esdm_type_index(esdm_dataspace_get_type(space));
+	esdm_reduce_kernel_t kernel = type < 0 ? NULL : esdm_reduce_kernels[plan->opcode][type];
+	if (!kernel)
+		return ESDM_ERROR;
 
-				double v = (double) result;
-				memcpy(stream_data->buff, &v, sizeof(v));
+	if ((plan->opcode == ESDM_OP_HISTOGRAM) || (plan->opcode == ESDM_OP_QUANTILE) || (plan->opcode == ESDM_OP_ARGMAX)
+	    || (plan->opcode == ESDM_OP_ARGMIN) || (plan->opcode == ESDM_OP_COUNT_DISTINCT)) {
+		kernel(stream_data, NULL);
+		return ESDM_SUCCESS;
+	}
 
-			}
+	// Shards are merged in order and the result is written into the output buffer once
+	int i;
+	esdm_stream_data_out_t tmp;
+	memset(&tmp, 0, sizeof(esdm_stream_data_out_t));
+	for (i = 0; i < ESDM_STREAM_SHARD_N; ++i) {
+		esdm_stream_data_out_t *acc = &context->shard[i].acc;
+		if ((plan->opcode == ESDM_OP_STD) || (plan->opcode == ESDM_OP_VAR))
+			esdm_stream_unshift(context->shard[i].shift, acc->number, &acc->value1, &acc->value2);
+		else if (plan->opcode == ESDM_OP_STAT) {
+			esdm_stream_unshift(context->shard[i].shift, acc->number, &acc->value3, &acc->value4);
+			acc->value3 = context->shard[i].sum;
+		}
+		else if ((plan->opcode == ESDM_OP_WSTD) || (plan->opcode == ESDM_OP_WVAR))
+			esdm_stream_unshift(context->shard[i].shift, acc->value3, &acc->value1, &acc->value2);
+		esdm_stream_merge(plan, &tmp, acc);
+	}
+	if (!esdm_stream_is_empty(plan, &tmp))
+		kernel(stream_data, &tmp);
+	esdm_stream_shards_reset(context);
 
-		} else if (!strcmp(stream_data->operation, ESDM_FUNCTION_STAT)) {
+	return ESDM_SUCCESS;
+}
 
-			if (!tmp)
-				break;
+static int esdm_compare_key(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
 
-			char i, option = 0, tbyte = 1, *arg = stream_data->args;
-			size_t offset = 0;
-			for (i = 0; i < ESDM_FUNCTION_OP_N; ++i)
-				if (arg && arg[0]) {
-					if (arg[0] == ESDM_FUNCTION_OP_SET)
-						option |= tbyte;
-					arg++;
-					tbyte <<= 1;
-				} else
-					break;
+// To be called at the end of each read in case of ESDM_FUNCTION_PERCENTILE: 1 is returned in case the dataspace has to be read again,
+// 0 once the percentiles have been written into the output buffer, -1 in case of error (e.g. the state of the next pass cannot be allocated)
+int esdm_stream_next_pass(esdm_dataspace_t * space, void *user_ptr)
+{
+	esdm_stream_data_t *stream_data = (esdm_stream_data_t *) user_ptr;
+	if (!space || !stream_data || esdm_stream_prepare(stream_data))
+		return -1;
+	if (stream_data->context->plan.opcode != ESDM_OP_PERCENTILE)
+		return 0;
 
-			if (option & 4) {
-				if (!stream_data->valid) {
-					stream_data->value1 = 0;
-					stream_data->number = 0;
-				}
-				stream_data->value1 += tmp->value3;
-				stream_data->number += tmp->number;
-			}
+	int type = esdm_type_index(esdm_dataspace_get_type(space));
+	esdm_stream_plan_t *plan = &stream_data->context->plan;
+	esdm_percentile_t *state = (esdm_percentile_t *) plan->cells;
+	if ((type < 0) || !state || !state->pending)
+		return 0;
 
-			if (type == SMD_DTYPE_INT8) {
-
-				char v, pre;
-				if (option & 1) {
-					v = (char) tmp->value1;
-					if (stream_data->valid) {
-						pre = *(char *) stream_data->buff;
-						if (pre > v)
-							memcpy(stream_data->buff, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 2) {
-					v = (char) tmp->value2;
-					if (stream_data->valid) {
-						pre = *((char *) (stream_data->buff + offset));
-						if (pre < v)
-							memcpy(stream_data->buff + offset, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff + offset, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 4) {
-					v = (char) (stream_data->value1 / stream_data->number);
-					memcpy(stream_data->buff + offset, &v, sizeof(v));
-					//offset += sizeof(v);  // Useless
-				}
-				stream_data->valid = 1;
-
-			} else if (type == SMD_DTYPE_INT16) {
-
-				short v, pre;
-				if (option & 1) {
-					v = (short) tmp->value1;
-					if (stream_data->valid) {
-						pre = *(short *) stream_data->buff;
-						if (pre > v)
-							memcpy(stream_data->buff, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 2) {
-					v = (short) tmp->value2;
-					if (stream_data->valid) {
-						pre = *((short *) (stream_data->buff + offset));
-						if (pre < v)
-							memcpy(stream_data->buff + offset, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff + offset, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 4) {
-					v = (short) (stream_data->value1 / stream_data->number);
-					memcpy(stream_data->buff + offset, &v, sizeof(v));
-					//offset += sizeof(v);  // Useless
-				}
-				stream_data->valid = 1;
-
-			} else if (type == SMD_DTYPE_INT32) {
-
-				char v, pre;
-				if (option & 1) {
-					v = (int) tmp->value1;
-					if (stream_data->valid) {
-						pre = *(int *) stream_data->buff;
-						if (pre > v)
-							memcpy(stream_data->buff, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 2) {
-					v = (int) tmp->value2;
-					if (stream_data->valid) {
-						pre = *((int *) (stream_data->buff + offset));
-						if (pre < v)
-							memcpy(stream_data->buff + offset, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff + offset, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 4) {
-					v = (int) (stream_data->value1 / stream_data->number);
-					memcpy(stream_data->buff + offset, &v, sizeof(v));
-					//offset += sizeof(v);  // Useless
-				}
-				stream_data->valid = 1;
-
-			} else if (type == SMD_DTYPE_INT64) {
-
-				long long v, pre;
-				if (option & 1) {
-					v = (long long) tmp->value1;
-					if (stream_data->valid) {
-						pre = *(long long *) stream_data->buff;
-						if (pre > v)
-							memcpy(stream_data->buff, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 2) {
-					v = (long long) tmp->value2;
-					if (stream_data->valid) {
-						pre = *((long long *) (stream_data->buff + offset));
-						if (pre < v)
-							memcpy(stream_data->buff + offset, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff + offset, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 4) {
-					v = (long long) (stream_data->value1 / stream_data->number);
-					memcpy(stream_data->buff + offset, &v, sizeof(v));
-					//offset += sizeof(v);  // Useless
-				}
-				stream_data->valid = 1;
-
-			} else if (type == SMD_DTYPE_FLOAT) {
-
-				float v, pre;
-				if (option & 1) {
-					v = (float) tmp->value1;
-					if (stream_data->valid) {
-						pre = *(float *) stream_data->buff;
-						if (pre > v)
-							memcpy(stream_data->buff, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 2) {
-					v = (float) tmp->value2;
-					if (stream_data->valid) {
-						pre = *((float *) (stream_data->buff + offset));
-						if (pre < v)
-							memcpy(stream_data->buff + offset, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff + offset, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 4) {
-					v = (float) (stream_data->value1 / stream_data->number);
-					memcpy(stream_data->buff + offset, &v, sizeof(v));
-					//offset += sizeof(v);  // Useless
-				}
-				stream_data->valid = 1;
-
-			} else if (type == SMD_DTYPE_DOUBLE) {
-
-				double v, pre;
-				if (option & 1) {
-					v = (double) tmp->value1;
-					if (stream_data->valid) {
-						pre = *(double *) stream_data->buff;
-						if (pre > v)
-							memcpy(stream_data->buff, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 2) {
-					v = (double) tmp->value2;
-					if (stream_data->valid) {
-						pre = *((double *) (stream_data->buff + offset));
-						if (pre < v)
-							memcpy(stream_data->buff + offset, &v, sizeof(v));
-					} else
-						memcpy(stream_data->buff + offset, &v, sizeof(v));
-					offset += sizeof(v);
-				}
-				if (option & 4) {
-					v = (double) (stream_data->value1 / stream_data->number);
-					memcpy(stream_data->buff + offset, &v, sizeof(v));
-					//offset += sizeof(v);  // Useless
-				}
-				stream_data->valid = 1;
+	int i, g, bits = 8 * esdm_type_sizes[type];
+	uint64_t b, n, size, prefix[ESDM_QUANTILES_MAX], count[ESDM_QUANTILES_MAX];
+
+	if (!state->pass) {
+		// Ranks follow from the number of valid elements, counted by the first pass
+		for (b = n = 0; b < ESDM_PERCENTILE_BINS; ++b)
+			n += state->data[b];
+		if (!n)
+			return 0;
+		for (i = 0; i < plan->reduce; ++i) {
+			state->rank[i] = (uint64_t) ceil(plan->quantiles[i] * n);
+			state->rank[i] = state->rank[i] ? state->rank[i] : 1;
+		}
+	}
 
-			}
+	for (g = 0; g < state->groups; ++g)
+		if (state->group[g].collect)
+			qsort(state->data + state->group[g].offset, state->group[g].count, sizeof(uint64_t), esdm_compare_key);
+
+	// Each percentile is either selected among the keys collected for its group, or located in a bin of the histogram of its group
+	for (i = 0; i < plan->reduce; ++i) {
+		if ((g = state->group_of[i]) < 0)
+			continue;
+		esdm_percentile_group_t *group = state->group + g;
+		const uint64_t *data = state->data + group->offset;
+		if (group->collect) {
+			n = group->fill < group->count ? group->fill : group->count;
+			state->key[i] = n ? data[(state->rank[i] < n ? state->rank[i] : n) - 1] : group->prefix;
+			state->group_of[i] = -1;
+			state->pending--;
+			continue;
+		}
+		for (b = 0; (b < ESDM_PERCENTILE_BINS - 1) && (state->rank[i] > data[b]); ++b)
+			state->rank[i] -= data[b];
+		prefix[i] = group->prefix | ((b << (64 - ESDM_PERCENTILE_BITS)) >> group->shift);
+		count[i] = data[b];
+		if (group->shift + ESDM_PERCENTILE_BITS >= bits) {
+			// All the bits of the key are known
+			state->key[i] = prefix[i];
+			state->group_of[i] = -1;
+			state->pending--;
+		}
+	}
 
+	// Groups of the next pass, sharing the same shift
+	esdm_percentile_t next;
+	memcpy(&next, state, sizeof(esdm_percentile_t));
+	next.pass++;
+	next.groups = next.slots = 0;
+	for (i = 0, size = 0; i < plan->reduce; ++i) {
+		if (state->group_of[i] < 0)
+			continue;
+		for (g = 0; (g < next.groups) && (next.group[g].prefix != prefix[i]); ++g);
+		if (g == next.groups) {
+			esdm_percentile_group_t *group = next.group + next.groups++;
+			memset(group, 0, sizeof(esdm_percentile_group_t));
+			group->prefix = prefix[i];
+			group->shift = state->group[state->group_of[i]].shift + ESDM_PERCENTILE_BITS;
+			group->count = count[i];
+			group->collect = count[i] <= ESDM_PERCENTILE_COLLECT_MAX;
+			group->slot = group->collect ? -1 : next.slots++;
+			group->offset = size;
+			size += group->collect ? count[i] : ESDM_PERCENTILE_BINS;
 		}
+		next.group_of[i] = g;
+	}
 
-	} while (0);
+	// The previous state is kept in case of error, as the stream kernels may still be called
+	esdm_percentile_t *last = state;
+	if (!(state = malloc(sizeof(esdm_percentile_t) + size * sizeof(uint64_t))))
+		return -1;
+	free(last);
+	plan->cells = state;
+	memcpy(state, &next, sizeof(esdm_percentile_t));
+	memset(state->data, 0, size * sizeof(uint64_t));
+	if (state->pending)
+		return 1;
 
-	if (stream_func_out)
-		free(stream_func_out);
+	esdm_reduce_kernels[ESDM_OP_PERCENTILE][type] (stream_data, NULL);
+
+	return 0;
 }
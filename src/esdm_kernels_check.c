@@ -0,0 +1,205 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Accuracy of the vectorized elementary functions in accurate mode, compared with the math library evaluated in extended precision
+// at the edges of their domains, for each variant built and supported by the CPU: the exit status is not zero in case some result
+// is beyond the bound given in the documentation (1 ulp, 2.5 ulps for hyperbolic functions)
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esdm_kernels_internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ESDM_CPU_SUPPORTS(feature) __builtin_cpu_supports(feature)
+#else
+#define ESDM_CPU_SUPPORTS(feature) 0
+#endif
+
+#define ESDM_CHECK_VALUES_MAX 32
+
+typedef struct _esdm_check_t {
+	const char *name;
+	int opcode;
+	double y;		// Exponent of ESDM_OP_POW
+	double bound;		// Maximum error in ulps
+	size_t n;
+	double x[ESDM_CHECK_VALUES_MAX];
+} esdm_check_t;
+
+#define ESDM_CHECK(NAME, OPCODE, Y, BOUND, ...) { NAME, OPCODE, Y, BOUND, sizeof((double[]) { __VA_ARGS__ }) / sizeof(double), { __VA_ARGS__ } }
+
+// Edges of the domains of double-precision elements: subnormal arguments and results, overflow thresholds, large arguments
+// of trigonometric functions, which are reduced by the math library, and negative bases with integer exponents
+static const esdm_check_t esdm_check_double[] = {
+	ESDM_CHECK("exp", ESDM_OP_EXP, 0, 1, -746, -745.13321910194122, -745, -744.5, -740, -720, -708.5, -708.39641853226408, -1e-310, 4.9406564584124654e-324, 0,
+		   1e-300, 1, 709, 709.78271289338397, 710, NAN, INFINITY, -INFINITY),
+	ESDM_CHECK("log", ESDM_OP_LOG, 0, 1, 4.9406564584124654e-324, 1e-310, 2.2250738585072009e-308, 2.2250738585072014e-308, 0.99999999999999989, 1,
+		   1.0000000000000002, 1e300, DBL_MAX, 0, -1, INFINITY, NAN),
+	ESDM_CHECK("log10", ESDM_OP_LOG10, 0, 1, 4.9406564584124654e-324, 1e-310, 2.2250738585072014e-308, 0.1, 1, 10, 1e22, DBL_MAX, 0, -1, INFINITY),
+	ESDM_CHECK("sin", ESDM_OP_SIN, 0, 1, 1e-310, -1e-310, 1e-8, 3.1415926535897931, 1.5707963267948966, 355, 1e6, 1e9, 1e15, -1e22, 1e22, 1e300,
+		   DBL_MAX, -DBL_MAX, INFINITY, NAN),
+	ESDM_CHECK("cos", ESDM_OP_COS, 0, 1, 1e-310, 1.5707963267948966, 3.1415926535897931, 355, 1e6, 1e9, 1e15, 1e22, -1e22, 1e300, DBL_MAX, INFINITY),
+	ESDM_CHECK("tan", ESDM_OP_TAN, 0, 1, 1e-310, 0.78539816339744828, 1.5707963267948966, -1.5707963267948966, 355, 1e6, 1e9, 1e15, 1e22, 1e300, DBL_MAX),
+	ESDM_CHECK("sinh", ESDM_OP_SINH, 0, 2.5, 1e-310, -1e-310, 1e-8, 0.99999999999999989, 1, 20, 709, 709.78, 710.47, -710.47, 710.5, 711, -711),
+	ESDM_CHECK("cosh", ESDM_OP_COSH, 0, 2.5, 1e-310, 0, 1, 20, 709, 709.78, 710.47, -710.47, 710.5, 711),
+	ESDM_CHECK("tanh", ESDM_OP_TANH, 0, 2.5, 1e-310, -1e-310, 1e-8, 0.62499999999999989, 0.625, 1, 19, 22, 40, -40, 711),
+	ESDM_CHECK("pow", ESDM_OP_POW, 3, 1, -2, -1.5, -1e-110, -1e103, -DBL_MAX, 1e-310, 2),
+	ESDM_CHECK("pow", ESDM_OP_POW, 2, 1, -2, -1.5, -1e-160, -1e154, -1e155),
+	ESDM_CHECK("pow", ESDM_OP_POW, -3, 1, -0.5, -2, -1e-103, -1e103, -1e-310),
+	ESDM_CHECK("pow", ESDM_OP_POW, 1023, 1, -2, -1.0000000000000002, -0.99999999999999989),
+	ESDM_CHECK("pow", ESDM_OP_POW, -1074, 1, -2, 2, -1.0000000000000002),
+	ESDM_CHECK("pow", ESDM_OP_POW, 0.5, 1, -2, 1e-310, 2, 0),
+	{NULL, 0, 0, 0, 0, {0}}
+};
+
+// Edges of the domains of single-precision elements
+static const esdm_check_t esdm_check_float[] = {
+	ESDM_CHECK("exp", ESDM_OP_EXP, 0, 1, -104, -103.97f, -103, -88, -87.5f, -1e-40f, 1.4e-45f, 0, 1, 88, 88.72f, 89, NAN, INFINITY, -INFINITY),
+	ESDM_CHECK("log", ESDM_OP_LOG, 0, 1, 1.4e-45f, 1e-40f, 1.17549435e-38f, 0.99999994f, 1, 1.0000001f, FLT_MAX, 0, -1, INFINITY),
+	ESDM_CHECK("log10", ESDM_OP_LOG10, 0, 1, 1.4e-45f, 1e-40f, 0.1f, 1, 10, 1e10f, FLT_MAX, 0, -1),
+	ESDM_CHECK("sin", ESDM_OP_SIN, 0, 1, 1e-40f, 3.14159274f, 1.57079637f, 355, 1e6f, 1e9f, 1e20f, -1e30f, FLT_MAX, INFINITY),
+	ESDM_CHECK("cos", ESDM_OP_COS, 0, 1, 1e-40f, 1.57079637f, 3.14159274f, 355, 1e6f, 1e9f, 1e20f, -1e30f, FLT_MAX),
+	ESDM_CHECK("tan", ESDM_OP_TAN, 0, 1, 1e-40f, 0.785398185f, 1.57079637f, 355, 1e6f, 1e9f, 1e20f, FLT_MAX),
+	ESDM_CHECK("sinh", ESDM_OP_SINH, 0, 2.5, 1e-40f, 1e-4f, 1, 20, 88, 88.72f, 89.4f, -89.4f, 89.5f, 90),
+	ESDM_CHECK("cosh", ESDM_OP_COSH, 0, 2.5, 1e-40f, 0, 1, 20, 88, 88.72f, 89.4f, -89.4f, 89.5f, 90),
+	ESDM_CHECK("tanh", ESDM_OP_TANH, 0, 2.5, 1e-40f, 1e-4f, 0.625f, 1, 9, 10, -10, 90),
+	ESDM_CHECK("pow", ESDM_OP_POW, 3, 1, -2, -1.5f, -1e-20f, -1e13f, -FLT_MAX, 1e-40f),
+	ESDM_CHECK("pow", ESDM_OP_POW, -3, 1, -0.5f, -2, -1e-13f, -1e13f),
+	ESDM_CHECK("pow", ESDM_OP_POW, 127, 1, -2, -1.00000012f, -0.99999994f),
+	ESDM_CHECK("pow", ESDM_OP_POW, -149, 1, -2, 2, -1.00000012f),
+	ESDM_CHECK("pow", ESDM_OP_POW, 0.5f, 1, -2, 1e-40f, 2, 0),
+	{NULL, 0, 0, 0, 0, {0}}
+};
+
+static long double esdm_check_reference(int opcode, long double x, long double y)
+{
+	switch (opcode) {
+		case ESDM_OP_EXP:
+			return expl(x);
+		case ESDM_OP_LOG:
+			return logl(x);
+		case ESDM_OP_LOG10:
+			return log10l(x);
+		case ESDM_OP_SIN:
+			return sinl(x);
+		case ESDM_OP_COS:
+			return cosl(x);
+		case ESDM_OP_TAN:
+			return tanl(x);
+		case ESDM_OP_SINH:
+			return sinhl(x);
+		case ESDM_OP_COSH:
+			return coshl(x);
+		case ESDM_OP_TANH:
+			return tanhl(x);
+		case ESDM_OP_POW:
+			return powl(x, y);
+		default:
+			return NAN;
+	}
+}
+
+// Error of a result in units in the last place of the reference rounded to the type; special values have to be the same
+static double esdm_check_ulps(long double reference, double result, int single)
+{
+	long double r = single ? (long double) (float) reference : (long double) (double) reference, a = fabsl(reference), ulp;
+	if (isnan(r) || isnan(result))
+		return isnan(r) && isnan(result) ? 0 : INFINITY;
+	if (isinf(r) || isinf(result))
+		return r == result ? 0 : INFINITY;
+	if (single)
+		ulp = a < FLT_MIN ? FLT_TRUE_MIN : nextafterf((float) a, INFINITY) - (float) a;
+	else
+		ulp = a < DBL_MIN ? DBL_TRUE_MIN : nextafter((double) a, INFINITY) - (double) a;
+	return (double) (fabsl(reference - result) / ulp);
+}
+
+// Check the double and single-precision kernels of a variant, returning the number of results beyond the bound
+static int esdm_check_variant(const char *isa, const esdm_kernel_row_t * kernels)
+{
+	int failed = 0, single;
+	size_t i, n;
+	for (single = 0; single < 2; ++single) {
+		const esdm_check_t *check;
+		for (check = single ? esdm_check_float : esdm_check_double; check->name; ++check) {
+			esdm_stream_kernel_t kernel = kernels[check->opcode][single ? ESDM_TYPE_FLOAT : ESDM_TYPE_DOUBLE][ESDM_FILL_NONE];
+			double din[ESDM_CHECK_VALUES_MAX], dout[ESDM_CHECK_VALUES_MAX], result, error, worst = 0;
+			float fin[ESDM_CHECK_VALUES_MAX], fout[ESDM_CHECK_VALUES_MAX];
+			if (!kernel)
+				continue;
+
+			for (i = 0, n = check->n; i < n; ++i) {
+				din[i] = check->x[i];
+				fin[i] = (float) check->x[i];
+			}
+
+			esdm_stream_plan_t plan;
+			esdm_fragment_t fragment;
+			esdm_stream_data_out_t tmp;
+			memset(&plan, 0, sizeof(esdm_stream_plan_t));
+			memset(&fragment, 0, sizeof(esdm_fragment_t));
+			plan.opcode = check->opcode;
+			plan.dscalar = check->y;
+			fragment.in = single ? (void *) fin : (void *) din;
+			fragment.out = single ? (void *) fout : (void *) dout;
+			fragment.n = n;
+			kernel(&plan, &fragment, &tmp);
+
+			for (i = 0; i < n; ++i) {
+				long double x = single ? fin[i] : din[i];
+				result = single ? fout[i] : dout[i];
+				error = esdm_check_ulps(esdm_check_reference(check->opcode, x, single ? (float) check->y : check->y), result, single);
+				if (error > check->bound) {
+					printf("%s: %s(%.17g%s%.17g) of %s is %.17g, %.3g ulps away\n", isa, check->name, (double) x,
+					       check->opcode == ESDM_OP_POW ? ", " : "", check->opcode == ESDM_OP_POW ? check->y : 0.0, single ? "float" : "double", result, error);
+					failed++;
+				}
+				worst = error > worst ? error : worst;
+			}
+			if (check->opcode == ESDM_OP_POW)
+				printf("%s: %s(x, %g) of %s within %.3g ulps\n", isa, check->name, check->y, single ? "float" : "double", worst);
+			else
+				printf("%s: %s of %s within %.3g ulps\n", isa, check->name, single ? "float" : "double", worst);
+		}
+	}
+	return failed;
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	esdm_math_fast = 0;
+	failed += esdm_check_variant("generic", esdm_simd_kernels_generic);
+#ifdef HAVE_SIMD_SSE42
+	if (ESDM_CPU_SUPPORTS("sse4.2"))
+		failed += esdm_check_variant("sse42", esdm_simd_kernels_sse42);
+#endif
+#ifdef HAVE_SIMD_AVX2
+	if (ESDM_CPU_SUPPORTS("avx2") && ESDM_CPU_SUPPORTS("fma"))
+		failed += esdm_check_variant("avx2", esdm_simd_kernels_avx2);
+#endif
+#ifdef HAVE_SIMD_AVX512
+	if (ESDM_CPU_SUPPORTS("avx512f") && ESDM_CPU_SUPPORTS("avx512bw"))
+		failed += esdm_check_variant("avx512", esdm_simd_kernels_avx512);
+#endif
+
+	return failed ? 1 : 0;
+}
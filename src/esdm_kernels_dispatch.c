@@ -0,0 +1,126 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esdm_kernels_internal.h"
+
+// Environment variable used to force a given variant of the vectorized kernels
+#define ESDM_KERNELS_ISA "ESDM_KERNELS_ISA"
+#define ESDM_KERNELS_ISA_SCALAR "scalar"
+
+// Environment variable used to set the minimum size in bytes of the fragments processed by several threads
+#define ESDM_KERNELS_PARALLEL_BYTES "ESDM_KERNELS_PARALLEL_BYTES"
+#define ESDM_KERNELS_PARALLEL_BYTES_DEFAULT (64ULL * 1024 * 1024)
+
+// Environment variable used to select the accuracy of the vectorized elementary functions
+#define ESDM_KERNELS_MATH "ESDM_KERNELS_MATH"
+#define ESDM_KERNELS_MATH_FAST "fast"
+#define ESDM_KERNELS_MATH_ACCURATE "accurate"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ESDM_CPU_SUPPORTS(feature) __builtin_cpu_supports(feature)
+#else
+#define ESDM_CPU_SUPPORTS(feature) 0
+#endif
+
+typedef struct _esdm_simd_variant_t {
+	const char *name;
+	const esdm_kernel_row_t *kernels;
+	int supported;
+} esdm_simd_variant_t;
+
+const esdm_kernel_row_t *esdm_simd_kernels = esdm_simd_kernels_generic;
+static const char *esdm_simd_isa = "generic";
+
+#ifdef _OPENMP
+uint64_t esdm_parallel_bytes = ESDM_KERNELS_PARALLEL_BYTES_DEFAULT;
+#else
+uint64_t esdm_parallel_bytes = 0;
+#endif
+
+int esdm_math_fast = 0;
+
+const char *esdm_kernels_get_isa(void)
+{
+	return esdm_simd_isa;
+}
+
+static void __attribute__ ((constructor)) esdm_kernels_select_parallel(void)
+{
+#ifdef _OPENMP
+	const char *bytes = getenv(ESDM_KERNELS_PARALLEL_BYTES);
+	if (bytes && bytes[0])
+		esdm_parallel_bytes = strtoull(bytes, NULL, 10);
+#endif
+}
+
+static void __attribute__ ((constructor)) esdm_kernels_select_math(void)
+{
+	const char *math = getenv(ESDM_KERNELS_MATH);
+	if (!math || !math[0])
+		return;
+	if (!strcmp(math, ESDM_KERNELS_MATH_FAST))
+		esdm_math_fast = 1;
+	else if (strcmp(math, ESDM_KERNELS_MATH_ACCURATE))
+		fprintf(stderr, "ESDM kernels: accuracy '%s' is not available, '%s' will be used\n", math, ESDM_KERNELS_MATH_ACCURATE);
+}
+
+static void __attribute__ ((constructor)) esdm_kernels_select_isa(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+#endif
+
+	// Ordered from the most to the least powerful instruction set
+	esdm_simd_variant_t variants[] = {
+#ifdef HAVE_SIMD_AVX512
+		{"avx512", esdm_simd_kernels_avx512, ESDM_CPU_SUPPORTS("avx512f") && ESDM_CPU_SUPPORTS("avx512bw")},
+#endif
+#ifdef HAVE_SIMD_AVX2
+		{"avx2", esdm_simd_kernels_avx2, ESDM_CPU_SUPPORTS("avx2") && ESDM_CPU_SUPPORTS("fma")},
+#endif
+#ifdef HAVE_SIMD_SSE42
+		{"sse42", esdm_simd_kernels_sse42, ESDM_CPU_SUPPORTS("sse4.2")},
+#endif
+		{"generic", esdm_simd_kernels_generic, 1},
+		{ESDM_KERNELS_ISA_SCALAR, NULL, 1},
+		{NULL, NULL, 0}
+	};
+
+	int i;
+	const char *forced = getenv(ESDM_KERNELS_ISA);
+	if (forced && forced[0]) {
+		for (i = 0; variants[i].name; ++i)
+			if (!strcmp(forced, variants[i].name))
+				break;
+		if (variants[i].name && variants[i].supported) {
+			esdm_simd_kernels = variants[i].kernels;
+			esdm_simd_isa = variants[i].name;
+			return;
+		}
+		fprintf(stderr, "ESDM kernels: instruction set '%s' is not available, it will be selected automatically\n", forced);
+	}
+
+	for (i = 0; variants[i].name; ++i)
+		if (variants[i].supported)
+			break;
+	esdm_simd_kernels = variants[i].kernels;
+	esdm_simd_isa = variants[i].name;
+}
@@ -0,0 +1,319 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+#include "esdm_kernels_internal.h"
+
+#define ESDM_EXPR_VARIABLE "x"
+
+static const struct {
+	const char *name;
+	esdm_expr_op_t op;
+	int arity;
+} esdm_expr_functions[] = {
+	{"abs", ESDM_EXPR_ABS, 1},
+	{"sqrt", ESDM_EXPR_SQRT, 1},
+	{"exp", ESDM_EXPR_EXP, 1},
+	{"log", ESDM_EXPR_LOG, 1},
+	{"log10", ESDM_EXPR_LOG10, 1},
+	{"sin", ESDM_EXPR_SIN, 1},
+	{"cos", ESDM_EXPR_COS, 1},
+	{"tan", ESDM_EXPR_TAN, 1},
+	{"asin", ESDM_EXPR_ASIN, 1},
+	{"acos", ESDM_EXPR_ACOS, 1},
+	{"atan", ESDM_EXPR_ATAN, 1},
+	{"sinh", ESDM_EXPR_SINH, 1},
+	{"cosh", ESDM_EXPR_COSH, 1},
+	{"tanh", ESDM_EXPR_TANH, 1},
+	{"ceil", ESDM_EXPR_CEIL, 1},
+	{"floor", ESDM_EXPR_FLOOR, 1},
+	{"round", ESDM_EXPR_ROUND, 1},
+	{"pow", ESDM_EXPR_POW, 2},
+	{"min", ESDM_EXPR_MIN, 2},
+	{"max", ESDM_EXPR_MAX, 2},
+	{NULL, ESDM_EXPR_COPY, 0}
+};
+
+// Value of an operation, used to fold constants and to evaluate the instructions
+#define ESDM_EXPR_VALUE(OP, p, q) \
+	((OP) == ESDM_EXPR_ADD ? (p) + (q) : (OP) == ESDM_EXPR_SUB ? (p) - (q) : (OP) == ESDM_EXPR_MUL ? (p) * (q) : (OP) == ESDM_EXPR_DIV ? (p) / (q) : \
+	 (OP) == ESDM_EXPR_POW ? pow(p, q) : (OP) == ESDM_EXPR_MIN ? ((q) < (p) ? (q) : (p)) : (OP) == ESDM_EXPR_MAX ? ((q) > (p) ? (q) : (p)) : \
+	 (OP) == ESDM_EXPR_NEG ? -(p) : (OP) == ESDM_EXPR_ABS ? fabs(p) : (OP) == ESDM_EXPR_SQRT ? sqrt(p) : (OP) == ESDM_EXPR_EXP ? exp(p) : \
+	 (OP) == ESDM_EXPR_LOG ? log(p) : (OP) == ESDM_EXPR_LOG10 ? log10(p) : (OP) == ESDM_EXPR_SIN ? sin(p) : (OP) == ESDM_EXPR_COS ? cos(p) : \
+	 (OP) == ESDM_EXPR_TAN ? tan(p) : (OP) == ESDM_EXPR_ASIN ? asin(p) : (OP) == ESDM_EXPR_ACOS ? acos(p) : (OP) == ESDM_EXPR_ATAN ? atan(p) : \
+	 (OP) == ESDM_EXPR_SINH ? sinh(p) : (OP) == ESDM_EXPR_COSH ? cosh(p) : (OP) == ESDM_EXPR_TANH ? tanh(p) : (OP) == ESDM_EXPR_CEIL ? ceil(p) : \
+	 (OP) == ESDM_EXPR_FLOOR ? floor(p) : (OP) == ESDM_EXPR_ROUND ? floor((p) + 0.5) : (p))
+
+// Parser: the result of each subexpression is either a register or a constant (ESDM_EXPR_CONST).
+// Registers are allocated as a stack, so that the operands of an instruction are the last ones allocated.
+typedef struct _esdm_expr_parser_t {
+	const char *p;
+	esdm_expr_t *expr;
+	int top;		// First free register
+	int error;
+} esdm_expr_parser_t;
+
+typedef struct _esdm_expr_operand_t {
+	int reg;
+	double k;
+} esdm_expr_operand_t;
+
+static esdm_expr_operand_t esdm_expr_parse_sum(esdm_expr_parser_t * parser);
+
+static void esdm_expr_skip(esdm_expr_parser_t * parser)
+{
+	while (isspace((unsigned char) parser->p[0]))
+		parser->p++;
+}
+
+// Append an instruction, folding constants and reusing the registers of the operands
+static esdm_expr_operand_t esdm_expr_emit(esdm_expr_parser_t * parser, esdm_expr_op_t op, esdm_expr_operand_t a, esdm_expr_operand_t b)
+{
+	esdm_expr_operand_t result = { ESDM_EXPR_CONST, 0 };
+	if ((a.reg == ESDM_EXPR_CONST) && (b.reg == ESDM_EXPR_CONST) && (op != ESDM_EXPR_COPY)) {
+		result.k = ESDM_EXPR_VALUE(op, a.k, b.k);
+		return result;
+	}
+	if ((b.reg != ESDM_EXPR_CONST) && b.reg)
+		parser->top--;
+	if ((a.reg != ESDM_EXPR_CONST) && a.reg)
+		parser->top--;
+	result.reg = parser->top++;
+	if ((parser->expr->size >= ESDM_EXPR_CODE_MAX) || (parser->top > ESDM_EXPR_REGISTERS)) {
+		parser->error = 1;
+		return result;
+	}
+	if (parser->top > parser->expr->registers)
+		parser->expr->registers = parser->top;
+
+	esdm_expr_code_t *code = parser->expr->code + parser->expr->size++;
+	code->op = op;
+	code->dst = result.reg;
+	code->a = a.reg;
+	code->b = b.reg;
+	code->k = a.reg == ESDM_EXPR_CONST ? a.k : b.k;
+	return result;
+}
+
+static esdm_expr_operand_t esdm_expr_parse_primary(esdm_expr_parser_t * parser)
+{
+	esdm_expr_operand_t result = { ESDM_EXPR_CONST, 0 }, none = { ESDM_EXPR_CONST, 0 };
+	esdm_expr_skip(parser);
+	const char *p = parser->p;
+
+	if (p[0] == '(') {
+		parser->p++;
+		result = esdm_expr_parse_sum(parser);
+		esdm_expr_skip(parser);
+		if (parser->p[0] != ')')
+			parser->error = 1;
+		else
+			parser->p++;
+		return result;
+	}
+
+	if (isdigit((unsigned char) p[0]) || (p[0] == '.')) {
+		char *end = NULL;
+		result.k = strtod(p, &end);
+		if (end == p)
+			parser->error = 1;
+		parser->p = end;
+		return result;
+	}
+
+	size_t len = 0;
+	while (isalnum((unsigned char) p[len]) || (p[len] == '_'))
+		len++;
+	if (!len) {
+		parser->error = 1;
+		return result;
+	}
+	parser->p += len;
+	if ((len == strlen(ESDM_EXPR_VARIABLE)) && !strncmp(p, ESDM_EXPR_VARIABLE, len)) {
+		result.reg = 0;
+		return result;
+	}
+	if ((len == 2) && !strncmp(p, "pi", len)) {
+		result.k = 3.14159265358979323846;
+		return result;
+	}
+
+	int i;
+	for (i = 0; esdm_expr_functions[i].name; ++i)
+		if (!strncmp(p, esdm_expr_functions[i].name, len) && !esdm_expr_functions[i].name[len])
+			break;
+	esdm_expr_skip(parser);
+	if (!esdm_expr_functions[i].name || (parser->p[0] != '(')) {
+		parser->error = 1;
+		return result;
+	}
+	parser->p++;
+	esdm_expr_operand_t a = esdm_expr_parse_sum(parser), b = none;
+	esdm_expr_skip(parser);
+	if (esdm_expr_functions[i].arity > 1) {
+		if (parser->p[0] != ESDM_SEPARATOR[0]) {
+			parser->error = 1;
+			return result;
+		}
+		parser->p++;
+		b = esdm_expr_parse_sum(parser);
+		esdm_expr_skip(parser);
+	}
+	if (parser->p[0] != ')') {
+		parser->error = 1;
+		return result;
+	}
+	parser->p++;
+	return esdm_expr_emit(parser, esdm_expr_functions[i].op, a, b);
+}
+
+// Powers are right-associative and bind more tightly than the unary minus, e.g. -x^2 = -(x^2)
+static esdm_expr_operand_t esdm_expr_parse_unary(esdm_expr_parser_t * parser);
+
+static esdm_expr_operand_t esdm_expr_parse_power(esdm_expr_parser_t * parser)
+{
+	esdm_expr_operand_t a = esdm_expr_parse_primary(parser);
+	esdm_expr_skip(parser);
+	if (parser->error || (parser->p[0] != '^'))
+		return a;
+	parser->p++;
+	return esdm_expr_emit(parser, ESDM_EXPR_POW, a, esdm_expr_parse_unary(parser));
+}
+
+static esdm_expr_operand_t esdm_expr_parse_unary(esdm_expr_parser_t * parser)
+{
+	esdm_expr_operand_t none = { ESDM_EXPR_CONST, 0 };
+	esdm_expr_skip(parser);
+	if (parser->p[0] == '+') {
+		parser->p++;
+		return esdm_expr_parse_unary(parser);
+	}
+	if (parser->p[0] == '-') {
+		parser->p++;
+		return esdm_expr_emit(parser, ESDM_EXPR_NEG, esdm_expr_parse_unary(parser), none);
+	}
+	return esdm_expr_parse_power(parser);
+}
+
+static esdm_expr_operand_t esdm_expr_parse_product(esdm_expr_parser_t * parser)
+{
+	esdm_expr_operand_t a = esdm_expr_parse_unary(parser);
+	for (esdm_expr_skip(parser); !parser->error && ((parser->p[0] == '*') || (parser->p[0] == '/')); esdm_expr_skip(parser)) {
+		esdm_expr_op_t op = parser->p++[0] == '*' ? ESDM_EXPR_MUL : ESDM_EXPR_DIV;
+		a = esdm_expr_emit(parser, op, a, esdm_expr_parse_unary(parser));
+	}
+	return a;
+}
+
+static esdm_expr_operand_t esdm_expr_parse_sum(esdm_expr_parser_t * parser)
+{
+	esdm_expr_operand_t a = esdm_expr_parse_product(parser);
+	for (esdm_expr_skip(parser); !parser->error && ((parser->p[0] == '+') || (parser->p[0] == '-')); esdm_expr_skip(parser)) {
+		esdm_expr_op_t op = parser->p++[0] == '+' ? ESDM_EXPR_ADD : ESDM_EXPR_SUB;
+		a = esdm_expr_emit(parser, op, a, esdm_expr_parse_product(parser));
+	}
+	return a;
+}
+
+esdm_status esdm_expr_compile(esdm_expr_t * expr, const char *text)
+{
+	if (!expr || !text)
+		return ESDM_ERROR;
+
+	esdm_expr_parser_t parser;
+	memset(expr, 0, sizeof(esdm_expr_t));
+	memset(&parser, 0, sizeof(esdm_expr_parser_t));
+	parser.p = text;
+	parser.expr = expr;
+	parser.top = expr->registers = 1;	// Register 0 holds the elements
+
+	esdm_expr_operand_t result = esdm_expr_parse_sum(&parser);
+	esdm_expr_skip(&parser);
+	if (parser.error || parser.p[0])
+		return ESDM_ERROR;
+
+	if (result.reg == ESDM_EXPR_CONST) {
+		// Constant expressions are copied into a register
+		esdm_expr_operand_t none = { ESDM_EXPR_CONST, 0 };
+		result = esdm_expr_emit(&parser, ESDM_EXPR_COPY, result, none);
+		if (parser.error)
+			return ESDM_ERROR;
+	}
+	expr->result = result.reg;
+
+	return ESDM_SUCCESS;
+}
+
+// Each instruction is applied to a block of elements, so that the loops can be vectorized and the cost of decoding
+// the instruction is shared by all the elements of the block
+#define ESDM_EXPR_LOOP(OP) \
+		case OP: \
+			if (code->a == ESDM_EXPR_CONST) \
+				for (i = 0; i < n; ++i) \
+					d[i] = ESDM_EXPR_VALUE(OP, k, b[i]); \
+			else if (code->b == ESDM_EXPR_CONST) \
+				for (i = 0; i < n; ++i) \
+					d[i] = ESDM_EXPR_VALUE(OP, a[i], k); \
+			else \
+				for (i = 0; i < n; ++i) \
+					d[i] = ESDM_EXPR_VALUE(OP, a[i], b[i]); \
+			break;
+
+void esdm_expr_run(const esdm_expr_t * expr, double (*reg)[ESDM_EXPR_BLOCK], int n)
+{
+	int c, i;
+	for (c = 0; c < expr->size; ++c) {
+		const esdm_expr_code_t *code = expr->code + c;
+		double *d = reg[code->dst], k = code->k;
+		const double *a = reg[code->a == ESDM_EXPR_CONST ? 0 : code->a], *b = reg[code->b == ESDM_EXPR_CONST ? 0 : code->b];
+		switch (code->op) {
+			ESDM_EXPR_LOOP(ESDM_EXPR_ADD)
+			ESDM_EXPR_LOOP(ESDM_EXPR_SUB)
+			ESDM_EXPR_LOOP(ESDM_EXPR_MUL)
+			ESDM_EXPR_LOOP(ESDM_EXPR_DIV)
+			ESDM_EXPR_LOOP(ESDM_EXPR_POW)
+			ESDM_EXPR_LOOP(ESDM_EXPR_MIN)
+			ESDM_EXPR_LOOP(ESDM_EXPR_MAX)
+			ESDM_EXPR_LOOP(ESDM_EXPR_NEG)
+			ESDM_EXPR_LOOP(ESDM_EXPR_COPY)
+			ESDM_EXPR_LOOP(ESDM_EXPR_ABS)
+			ESDM_EXPR_LOOP(ESDM_EXPR_SQRT)
+			ESDM_EXPR_LOOP(ESDM_EXPR_EXP)
+			ESDM_EXPR_LOOP(ESDM_EXPR_LOG)
+			ESDM_EXPR_LOOP(ESDM_EXPR_LOG10)
+			ESDM_EXPR_LOOP(ESDM_EXPR_SIN)
+			ESDM_EXPR_LOOP(ESDM_EXPR_COS)
+			ESDM_EXPR_LOOP(ESDM_EXPR_TAN)
+			ESDM_EXPR_LOOP(ESDM_EXPR_ASIN)
+			ESDM_EXPR_LOOP(ESDM_EXPR_ACOS)
+			ESDM_EXPR_LOOP(ESDM_EXPR_ATAN)
+			ESDM_EXPR_LOOP(ESDM_EXPR_SINH)
+			ESDM_EXPR_LOOP(ESDM_EXPR_COSH)
+			ESDM_EXPR_LOOP(ESDM_EXPR_TANH)
+			ESDM_EXPR_LOOP(ESDM_EXPR_CEIL)
+			ESDM_EXPR_LOOP(ESDM_EXPR_FLOOR)
+			ESDM_EXPR_LOOP(ESDM_EXPR_ROUND)
+			default:
+				break;
+		}
+	}
+}
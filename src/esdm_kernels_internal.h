@@ -0,0 +1,564 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ESDM_KERNELS_INTERNAL_H
+#define __ESDM_KERNELS_INTERNAL_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "esdm_kernels.h"
+
+#define UNUSED(x) {(void)(x);}
+
+#define ESDM_FUNCTION_OP_SET '1'
+#define ESDM_FUNCTION_OP_LESS_THAN '<'
+#define ESDM_FUNCTION_OP_MORE_THAN '>'
+#define ESDM_FUNCTION_OP_EDGES ':'
+#define ESDM_FUNCTION_OP_SKETCH ':'
+#define ESDM_FUNCTION_OP_CYCLE '%'
+#define ESDM_FUNCTION_OP_CHAIN '|'
+#define ESDM_FUNCTION_OP_ARG ':'
+
+#define ESDM_STAT_BIT(S) (1 << (S))
+#define ESDM_STAT_SUMS (ESDM_STAT_BIT(ESDM_STAT_AVG) | ESDM_STAT_BIT(ESDM_STAT_STD) | ESDM_STAT_BIT(ESDM_STAT_VAR) | ESDM_STAT_BIT(ESDM_STAT_SUM))
+#define ESDM_STAT_SQUARES (ESDM_STAT_BIT(ESDM_STAT_STD) | ESDM_STAT_BIT(ESDM_STAT_VAR))
+
+// Element-wise operation of a chain, with its scalar argument
+typedef struct _esdm_stream_step_t {
+	int opcode;
+	long long iscalar;
+	unsigned long long uscalar;
+	double dscalar;
+} esdm_stream_step_t;
+
+// Maximum number of instructions and registers of the program compiled from the expression of ESDM_FUNCTION_EXPR
+#define ESDM_EXPR_CODE_MAX 64
+#define ESDM_EXPR_REGISTERS 16
+
+// Instruction of the program: register dst is set to the result of op applied to registers a and b,
+// where an operand equal to ESDM_EXPR_CONST stands for the constant k
+typedef struct _esdm_expr_code_t {
+	unsigned char op;
+	unsigned char dst;
+	unsigned char a;
+	unsigned char b;
+	double k;
+} esdm_expr_code_t;
+
+typedef struct _esdm_expr_t {
+	int size;		// Number of instructions
+	int registers;		// Number of registers used, register 0 holding the elements
+	int result;		// Register holding the result
+	esdm_expr_code_t code[ESDM_EXPR_CODE_MAX];
+} esdm_expr_t;
+
+typedef struct _esdm_stream_plan_t {
+	const char *operation;	// Strings the plan has been compiled from
+	const char *args;
+	int opcode;
+	int reduce;		// Number of output values in case of reduction, 0 otherwise
+	int option;		// Bit mask of the statistics evaluated by ESDM_FUNCTION_STAT
+	char thresh_type;
+	char has_scalar;
+	char concurrent;	// Partial results are merged into shards and written into the output buffer by esdm_reduce_finalize
+	uint64_t axes;		// Bit mask of the dimensions collapsed by axis-wise reductions, 0 in case all of them are collapsed
+	int cyclic;		// Dimension whose elements are grouped by cyclic index (e.g. months of a climatology) in case period is not 0
+	int64_t period;		// Number of groups: the element at global position t along the dimension falls in the group (t + phase) mod period
+	int64_t phase;
+	int64_t window;		// Length of the window of rolling reductions
+	int window_dim;		// Dimension along which the window slides
+	int chain;		// Number of element-wise operations fused into a chain, applied before the reduction unless opcode is ESDM_OP_CHAIN
+	esdm_stream_step_t steps[ESDM_CHAIN_MAX];
+	esdm_expr_t expr;	// Program evaluated by ESDM_FUNCTION_EXPR, also as a step of a chain
+	void *cells;		// Accumulators of axis-wise reductions, histograms, sketches, extremes and distinct values, released by esdm_stream_release
+	int bins;		// Number of bins of ESDM_FUNCTION_HISTOGRAM
+	char uniform;		// Bins have the same width: edges[0] and edges[1] are the bounds of the range
+	double edges[ESDM_HISTOGRAM_EDGES_MAX];
+	int sketch_size;	// Accuracy parameter of the sketch used by ESDM_FUNCTION_QUANTILE
+	double quantiles[ESDM_QUANTILES_MAX];	// Probabilities of ESDM_FUNCTION_QUANTILE and ESDM_FUNCTION_PERCENTILE, in [0, 1]
+	int precision;		// Number of bits selecting the register of the sketch used by ESDM_FUNCTION_COUNT_DISTINCT
+	long long iscalar;	// Scalar argument parsed for signed integer types
+	unsigned long long uscalar;	// Scalar argument parsed for unsigned integer types
+	double dscalar;		// Scalar argument parsed for floating-point types
+} esdm_stream_plan_t;
+
+// Partial result of a fragment: variances are tracked as the sum in value1 and M2, the sum of the squared deviations from the mean, in value2
+// (value3 and value4 in case of ESDM_FUNCTION_STAT); weighted reductions track the sum of the weights in value3
+typedef struct _esdm_stream_data_out_t {
+	double value1;
+	double value2;
+	double value3;
+	double value4;
+	uint64_t number;
+	uint64_t missing;	// Used by ESDM_FUNCTION_STAT only
+	uint64_t outlier;
+	uint64_t index;		// Used by ESDM_FUNCTION_ARGMAX and ESDM_FUNCTION_ARGMIN: position of the extreme in the fragment, in row-major order
+	int64_t dims;		// Number of global coordinates of the extreme following the header
+} esdm_stream_data_out_t;
+
+#define ESDM_STREAM_POOL_SIZE 64
+
+// Partial results of the fragments being processed, so that no memory is allocated for each fragment: slots are allocated
+// on first use, grown to the largest payload stored after the header, and kept until the plan changes
+typedef struct _esdm_stream_pool_t {
+	esdm_stream_data_out_t *slot[ESDM_STREAM_POOL_SIZE];
+	size_t capacity[ESDM_STREAM_POOL_SIZE];	// Bytes of the payload each slot has room for
+	uint64_t used;		// Bit mask of the slots in use
+	esdm_stream_data_out_t last;	// Shared by element-wise operations, whose partial result is not merged
+} esdm_stream_pool_t;
+
+#define ESDM_STREAM_SHARD_N 8
+
+// Accumulator of the partial results merged concurrently, padded to a cache line to avoid false sharing
+typedef struct _esdm_stream_shard_t {
+	esdm_stream_data_out_t acc;
+	double shift;		// Moments are accumulated as sums of the deviations from this value, set by the first partial result
+	double sum;		// Sum of the elements merged by ESDM_FUNCTION_STAT, exact for integers unlike the one rebuilt from the deviations
+	char pad[(64 - (sizeof(esdm_stream_data_out_t) + 2 * sizeof(double)) % 64) % 64];
+} esdm_stream_shard_t;
+
+// State of a read, allocated by esdm_stream_prepare and released by esdm_stream_release: shards come first,
+// so that they are aligned to the cache line the context is allocated at
+struct _esdm_stream_context_t {
+	esdm_stream_shard_t shard[ESDM_STREAM_SHARD_N];
+	char *operation;	// Copies of the strings the plan has been compiled from, compared with the ones given at each call
+	char *args;
+	esdm_stream_plan_t plan;
+	esdm_stream_data_out_t stat;	// Running statistics of ESDM_FUNCTION_STAT and of weighted reductions
+	esdm_stream_pool_t pool;
+	char lock;		// Held while the output cells of axis-wise and rolling reductions are merged in concurrent mode
+	char failed;		// Set in case a partial result could not be merged in concurrent mode, reported by esdm_reduce_finalize
+};
+
+esdm_status esdm_stream_plan_compile(esdm_stream_plan_t * plan, const char *operation, const char *args);
+
+// Moments of a set of elements are kept as number, sum and M2, the sum of the squared deviations from the mean,
+// so that variances are not affected by cancellation; two sets are merged by the pairwise formula of Chan et al.
+static inline void esdm_moments_merge(uint64_t * n, double *sum, double *m2, uint64_t nb, double sumb, double m2b)
+{
+	if (!nb)
+		return;
+	if (*n) {
+		double delta = sumb / nb - *sum / *n;
+		*m2 += m2b + delta * delta * ((double) *n * nb / (*n + nb));
+	} else
+		*m2 = m2b;
+	*sum += sumb;
+	*n += nb;
+}
+
+// Welford update with an element, where n is the number of elements added before; the caller updates the number
+static inline void esdm_moments_add(uint64_t n, double *sum, double *m2, double x)
+{
+	if (n) {
+		double delta = x - *sum / n;
+		*m2 += delta * delta * n / (n + 1);
+	}
+	*sum += x;
+}
+
+// Weighted moments are kept as total weight, weighted sum and weighted M2, merged as above
+static inline void esdm_wmoments_merge(double *w, double *sum, double *m2, double wb, double sumb, double m2b)
+{
+	if (wb == 0)
+		return;
+	if (*w != 0) {
+		double delta = sumb / wb - *sum / *w;
+		*m2 += m2b + delta * delta * (*w * wb / (*w + wb));
+	} else
+		*m2 = m2b;
+	*sum += sumb;
+	*w += wb;
+}
+
+// Weighted version of esdm_moments_add: x is added with weight wx
+static inline void esdm_wmoments_add(double *w, double *sum, double *m2, double wx, double x)
+{
+	if (wx == 0)
+		return;
+	if (*w != 0) {
+		double delta = x - *sum / *w;
+		*m2 += wx * delta * delta * (*w / (*w + wx));
+	}
+	*sum += wx * x;
+	*w += wx;
+}
+
+// Partial result of an output cell of axis-wise reductions
+typedef struct _esdm_axis_cell_t {
+	double value1;
+	double value2;
+	uint64_t number;
+} esdm_axis_cell_t;
+
+// Fragment to be processed by a kernel
+typedef struct _esdm_fragment_t {
+	const void *in;
+	void *out;
+	uint64_t n;
+	int64_t ndims;
+	int64_t const *size;
+	const void *fill_value;
+	int64_t const *stride;	// Used by axis-wise reductions: stride of each dimension in cells, 0 for collapsed dimensions
+	int64_t cyclic;		// Dimension grouped by cyclic index, -1 if none: the cell of an element is its coordinate modulo period,
+	int64_t period;		// mapped to its group by the offset of the fragment while merging
+	esdm_axis_cell_t *cells;
+	uint64_t first;		// Position of the first element in case the fragment is processed block by block
+	int64_t const *origin;	// Used by weighted reductions: position of the fragment in the dataspace being read
+	int64_t const *extent;	// Size of the dataspace being read
+	const double *const *weights;
+	const double *weight_array;
+	// Used by chains followed by a reduction, which is applied to blocks of transformed elements
+	void (*reduce)(const esdm_stream_plan_t * plan, const struct _esdm_fragment_t * f, esdm_stream_data_out_t * tmp);
+	void (*transform)(const esdm_stream_plan_t * plan, const struct _esdm_fragment_t * f, uint64_t first, void *out, uint64_t n);
+} esdm_fragment_t;
+
+// Operations of the programs compiled from expressions: binary ones precede unary ones
+typedef enum {
+	ESDM_EXPR_ADD,
+	ESDM_EXPR_SUB,
+	ESDM_EXPR_MUL,
+	ESDM_EXPR_DIV,
+	ESDM_EXPR_POW,
+	ESDM_EXPR_MIN,
+	ESDM_EXPR_MAX,
+	ESDM_EXPR_NEG,
+	ESDM_EXPR_COPY,
+	ESDM_EXPR_ABS,
+	ESDM_EXPR_SQRT,
+	ESDM_EXPR_EXP,
+	ESDM_EXPR_LOG,
+	ESDM_EXPR_LOG10,
+	ESDM_EXPR_SIN,
+	ESDM_EXPR_COS,
+	ESDM_EXPR_TAN,
+	ESDM_EXPR_ASIN,
+	ESDM_EXPR_ACOS,
+	ESDM_EXPR_ATAN,
+	ESDM_EXPR_SINH,
+	ESDM_EXPR_COSH,
+	ESDM_EXPR_TANH,
+	ESDM_EXPR_CEIL,
+	ESDM_EXPR_FLOOR,
+	ESDM_EXPR_ROUND
+} esdm_expr_op_t;
+
+#define ESDM_EXPR_CONST 0xff
+
+// Programs are evaluated on blocks of this number of elements, vector-at-a-time
+#define ESDM_EXPR_BLOCK 256
+
+esdm_status esdm_expr_compile(esdm_expr_t * expr, const char *text);
+void esdm_expr_run(const esdm_expr_t * expr, double (*reg)[ESDM_EXPR_BLOCK], int n);
+
+// Maximum number of levels of a sketch, enough to summarize 2^64 items
+#define ESDM_SKETCH_LEVELS 64
+
+// Mergeable quantile sketch (KLL): items of level h stand for 2^h items of the input.
+// Levels are stored one after another in item[], from the highest one to level 0, so that items are appended to level 0.
+typedef struct _esdm_sketch_t {
+	uint32_t k;		// Accuracy parameter
+	uint32_t levels;	// Number of levels in use
+	uint32_t size;		// Number of items stored
+	uint32_t limit;		// Levels are compacted when size reaches this value
+	uint32_t capacity;	// Number of items that fit in item[]
+	char lock;		// Held while merging in concurrent mode
+	uint64_t n;		// Number of items summarized
+	uint64_t parity;	// Bit h selects the half kept by the next compaction of level h
+	double min;
+	double max;
+	uint32_t count[ESDM_SKETCH_LEVELS];	// Number of items of each level
+	uint32_t width[ESDM_SKETCH_LEVELS];	// Capacity of each level
+	double item[];
+} esdm_sketch_t;
+
+size_t esdm_sketch_bytes(uint32_t k);
+void esdm_sketch_init(esdm_sketch_t * sketch, uint32_t k);
+void esdm_sketch_compress(esdm_sketch_t * sketch);
+esdm_status esdm_sketch_merge(esdm_sketch_t * sketch, const esdm_sketch_t * other);
+esdm_status esdm_sketch_quantiles(const esdm_sketch_t * sketch, const double *q, int n, double *out);
+
+static inline void esdm_sketch_add(esdm_sketch_t * sketch, double x)
+{
+	if (x != x)
+		return;		// NaN cannot be ranked
+	sketch->item[sketch->size++] = x;
+	sketch->count[0]++;
+	sketch->n++;
+	sketch->min = x < sketch->min ? x : sketch->min;
+	sketch->max = x > sketch->max ? x : sketch->max;
+	if (sketch->size >= sketch->limit)
+		esdm_sketch_compress(sketch);
+}
+
+// Accumulator of ESDM_FUNCTION_ARGMAX and ESDM_FUNCTION_ARGMIN: the extreme found so far and its global coordinates
+typedef struct _esdm_arg_t {
+	char lock;		// Held while merging in concurrent mode
+	esdm_stream_data_out_t head;
+	int64_t coord[ESDM_ARG_DIMS_MAX];
+} esdm_arg_t;
+
+// Distinct values of 8 and 16-bit types are marked in a bitmap, the other ones are hashed into the registers of a sketch
+#define ESDM_DISTINCT_EXACT(size) ((size) <= sizeof(short))
+#define ESDM_DISTINCT_WORDS(size) (ESDM_DISTINCT_EXACT(size) ? 1ULL << (8 * (size) - 6) : 0)
+
+// Accumulator of ESDM_FUNCTION_COUNT_DISTINCT: partial results hold either the bitmap or the registers after the header
+typedef struct _esdm_distinct_t {
+	uint64_t number;
+	uint64_t bitmap[ESDM_DISTINCT_WORDS(sizeof(short))];
+	uint8_t reg[];
+} esdm_distinct_t;
+
+double esdm_distinct_estimate(const uint8_t * reg, int precision);
+
+// Mix the bits of a key (finalizer of MurmurHash3), so that the leading ones are uniformly distributed
+static inline uint64_t esdm_distinct_hash(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+// The leading bits of the hash select the register, which keeps the maximum rank of the first bit set among the other ones
+static inline void esdm_distinct_add(uint8_t * reg, int precision, uint64_t hash)
+{
+	uint64_t rest = hash << precision;
+	uint8_t rank = rest ? __builtin_clzll(rest) + 1 : 64 - precision + 1;
+	if (reg[hash >> (64 - precision)] < rank)
+		reg[hash >> (64 - precision)] = rank;
+}
+
+// Exact percentiles: bits of the order-preserving keys of the elements fixed at each pass and number of bins of each histogram
+#define ESDM_PERCENTILE_BITS 12
+#define ESDM_PERCENTILE_BINS (1 << ESDM_PERCENTILE_BITS)
+
+// Elements whose keys start with the same bits, either counted by a histogram or collected
+typedef struct _esdm_percentile_group_t {
+	uint64_t prefix;	// Bits fixed so far, aligned to the left
+	int shift;		// Number of bits fixed
+	char collect;
+	int slot;		// Histogram of the group in the partial results
+	uint64_t count;		// Number of elements of the group, known from the previous pass
+	uint64_t fill;		// Number of elements collected so far
+	uint64_t offset;	// Position of the counters or of the keys of the group in data[]
+} esdm_percentile_group_t;
+
+// State of ESDM_FUNCTION_PERCENTILE, updated by esdm_stream_next_pass at the end of each pass
+typedef struct _esdm_percentile_t {
+	int pass;
+	int groups;
+	int slots;		// Number of groups counted by a histogram
+	int pending;		// Number of percentiles not found yet
+	int group_of[ESDM_QUANTILES_MAX];	// Group of each percentile, -1 once it has been found
+	uint64_t rank[ESDM_QUANTILES_MAX];	// Rank of each percentile within its group, starting from 1
+	uint64_t key[ESDM_QUANTILES_MAX];	// Key of each percentile, once it has been found
+	esdm_percentile_group_t group[ESDM_QUANTILES_MAX];
+	uint64_t data[];
+} esdm_percentile_t;
+
+// Keys of the elements, aligned to the left, whose unsigned order is the order of the values
+static inline uint64_t esdm_key_signed(long long x, int bits)
+{
+	return ((uint64_t) x << (64 - bits)) ^ (1ULL << 63);
+}
+
+static inline uint64_t esdm_key_unsigned(unsigned long long x, int bits)
+{
+	return (uint64_t) x << (64 - bits);
+}
+
+static inline uint64_t esdm_key_float(float x)
+{
+	uint32_t u;
+	memcpy(&u, &x, sizeof(u));
+	return (uint64_t) (u >> 31 ? ~u : u | 0x80000000U) << 32;
+}
+
+static inline uint64_t esdm_key_double(double x)
+{
+	uint64_t u;
+	memcpy(&u, &x, sizeof(u));
+	return u >> 63 ? ~u : u | (1ULL << 63);
+}
+
+#define ESDM_IS_FLOATING(TYPE) ((TYPE) 0.5 != 0)
+
+#define ESDM_KEY(TYPE, LOWEST, X) (ESDM_IS_FLOATING(TYPE) ? (sizeof(TYPE) == sizeof(float) ? esdm_key_float(X) : esdm_key_double(X)) : \
+	(LOWEST) < 0 ? esdm_key_signed((long long) (X), 8 * sizeof(TYPE)) : esdm_key_unsigned((unsigned long long) (X), 8 * sizeof(TYPE)))
+
+// Value of a key, converted to the type
+#define ESDM_KEY_VALUE(TYPE, LOWEST, V, K) { \
+	if (ESDM_IS_FLOATING(TYPE) && (sizeof(TYPE) == sizeof(float))) { \
+		uint32_t u = (uint32_t) ((K) >> 32); \
+		float x; \
+		u = u >> 31 ? u & 0x7FFFFFFFU : ~u; \
+		memcpy(&x, &u, sizeof(x)); \
+		V = (TYPE) x; \
+	} else if (ESDM_IS_FLOATING(TYPE)) { \
+		uint64_t u = (K) >> 63 ? (K) & ~(1ULL << 63) : ~(K); \
+		double x; \
+		memcpy(&x, &u, sizeof(x)); \
+		V = (TYPE) x; \
+	} else if ((LOWEST) < 0) \
+		V = (TYPE) ((long long) ((K) ^ (1ULL << 63)) >> (64 - 8 * sizeof(TYPE))); \
+	else \
+		V = (TYPE) ((K) >> (64 - 8 * sizeof(TYPE))); \
+}
+
+typedef void (*esdm_stream_kernel_t)(const esdm_stream_plan_t * plan, const esdm_fragment_t * f, esdm_stream_data_out_t * tmp);
+typedef void (*esdm_transform_t)(const esdm_stream_plan_t * plan, const esdm_fragment_t * f, uint64_t first, void *out, uint64_t n);
+typedef void (*esdm_reduce_kernel_t)(esdm_stream_data_t * stream_data, const esdm_stream_data_out_t * tmp);
+
+typedef enum {
+	ESDM_OP_NOP,
+	ESDM_OP_MAX,
+	ESDM_OP_MIN,
+	ESDM_OP_AVG,
+	ESDM_OP_SUM,
+	ESDM_OP_STD,
+	ESDM_OP_VAR,
+	ESDM_OP_STAT,
+	ESDM_OP_OUTLIER,
+	ESDM_OP_HISTOGRAM,
+	ESDM_OP_QUANTILE,
+	ESDM_OP_PERCENTILE,
+	ESDM_OP_ARGMAX,
+	ESDM_OP_ARGMIN,
+	ESDM_OP_COUNT_DISTINCT,
+	ESDM_OP_WSUM,
+	ESDM_OP_WAVG,
+	ESDM_OP_WSTD,
+	ESDM_OP_WVAR,
+	ESDM_OP_ROLLING_SUM,
+	ESDM_OP_ROLLING_AVG,
+	ESDM_OP_ROLLING_MIN,
+	ESDM_OP_ROLLING_MAX,
+	ESDM_OP_SUM_SCALAR,
+	ESDM_OP_MUL_SCALAR,
+	ESDM_OP_ABS,
+	ESDM_OP_SQR,
+	ESDM_OP_SQRT,
+	ESDM_OP_CEIL,
+	ESDM_OP_FLOOR,
+	ESDM_OP_ROUND,
+	ESDM_OP_POW,
+	ESDM_OP_EXP,
+	ESDM_OP_LOG,
+	ESDM_OP_LOG10,
+	ESDM_OP_SIN,
+	ESDM_OP_COS,
+	ESDM_OP_TAN,
+	ESDM_OP_ASIN,
+	ESDM_OP_ACOS,
+	ESDM_OP_ATAN,
+	ESDM_OP_SINH,
+	ESDM_OP_COSH,
+	ESDM_OP_TANH,
+	ESDM_OP_RECI,
+	ESDM_OP_NOT,
+	ESDM_OP_CHAIN,
+	ESDM_OP_EXPR,
+	ESDM_OP_N
+} esdm_opcode_t;
+
+typedef enum {
+	ESDM_TYPE_INT8,
+	ESDM_TYPE_INT16,
+	ESDM_TYPE_INT32,
+	ESDM_TYPE_INT64,
+	ESDM_TYPE_UINT8,
+	ESDM_TYPE_UINT16,
+	ESDM_TYPE_UINT32,
+	ESDM_TYPE_UINT64,
+	ESDM_TYPE_FLOAT,
+	ESDM_TYPE_DOUBLE,
+	ESDM_TYPE_N
+} esdm_type_index_t;
+
+// List of the supported types: index, C type, field of the plan holding the scalar argument,
+// signed integer type of the comparison masks, lowest and highest values
+#define ESDM_FOR_EACH_TYPE(X, ...) \
+	X(int8, char, iscalar, signed char, SCHAR_MIN, SCHAR_MAX, __VA_ARGS__) \
+	X(int16, short, iscalar, short, SHRT_MIN, SHRT_MAX, __VA_ARGS__) \
+	X(int32, int, iscalar, int, INT_MIN, INT_MAX, __VA_ARGS__) \
+	X(int64, long long, iscalar, long long, LLONG_MIN, LLONG_MAX, __VA_ARGS__) \
+	X(uint8, unsigned char, uscalar, signed char, 0, UCHAR_MAX, __VA_ARGS__) \
+	X(uint16, unsigned short, uscalar, short, 0, USHRT_MAX, __VA_ARGS__) \
+	X(uint32, unsigned int, uscalar, int, 0, UINT_MAX, __VA_ARGS__) \
+	X(uint64, unsigned long long, uscalar, long long, 0, ULLONG_MAX, __VA_ARGS__) \
+	X(float, float, dscalar, int, -INFINITY, INFINITY, __VA_ARGS__) \
+	X(double, double, dscalar, long long, -INFINITY, INFINITY, __VA_ARGS__)
+
+// Handling of missing values: stream kernels are specialized for each mode
+#define ESDM_FILL_NONE 0	// No fill value is given
+#define ESDM_FILL_VALUE 1	// Elements equal to the fill value are missing
+#define ESDM_FILL_NAN 2		// The fill value is NaN: NaN elements are missing
+#define ESDM_FILL_N 3
+
+#define ESDM_IS_VALID(MODE, X, FV) ((MODE) == ESDM_FILL_NONE ? 1 : (MODE) == ESDM_FILL_VALUE ? (X) != (FV) : (X) == (X))
+
+#define ESDM_FOR_EACH_MODE(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, KERNEL, ...) \
+	KERNEL(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, none, ESDM_FILL_NONE, __VA_ARGS__) \
+	KERNEL(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, value, ESDM_FILL_VALUE, __VA_ARGS__) \
+	KERNEL(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, nan, ESDM_FILL_NAN, __VA_ARGS__)
+
+// Generate a stream kernel for each type and fill mode
+#define ESDM_FOR_EACH_KERNEL(KERNEL, ...) ESDM_FOR_EACH_TYPE(ESDM_FOR_EACH_MODE, KERNEL, __VA_ARGS__)
+
+typedef esdm_stream_kernel_t esdm_kernel_row_t[ESDM_TYPE_N][ESDM_FILL_N];
+
+#define ESDM_KERNEL_ROW_ITEM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, PREFIX, OP) { PREFIX##_##OP##_##TNAME##_none, PREFIX##_##OP##_##TNAME##_value, PREFIX##_##OP##_##TNAME##_nan },
+#define ESDM_KERNEL_ROW(PREFIX, OP) { ESDM_FOR_EACH_TYPE(ESDM_KERNEL_ROW_ITEM, PREFIX, OP) }
+
+#define ESDM_TYPE_ROW_ITEM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, PREFIX, OP) PREFIX##_##OP##_##TNAME,
+#define ESDM_TYPE_ROW(PREFIX, OP) { ESDM_FOR_EACH_TYPE(ESDM_TYPE_ROW_ITEM, PREFIX, OP) }
+
+// Vectorized kernels, used in place of the stream kernels where available: a variant is built for each supported instruction set
+extern const esdm_kernel_row_t esdm_simd_kernels_generic[ESDM_OP_N];
+#ifdef HAVE_SIMD_SSE42
+extern const esdm_kernel_row_t esdm_simd_kernels_sse42[ESDM_OP_N];
+#endif
+#ifdef HAVE_SIMD_AVX2
+extern const esdm_kernel_row_t esdm_simd_kernels_avx2[ESDM_OP_N];
+#endif
+#ifdef HAVE_SIMD_AVX512
+extern const esdm_kernel_row_t esdm_simd_kernels_avx512[ESDM_OP_N];
+#endif
+
+// Variant selected at load time, NULL in case vectorized kernels are disabled
+extern const esdm_kernel_row_t *esdm_simd_kernels;
+
+// Fragments are split into blocks of this size when processed by several threads
+#define ESDM_PARALLEL_BLOCK_BYTES (256 * 1024)
+
+// Minimum size in bytes of a fragment processed by several threads, 0 in case parallel mode is disabled
+extern uint64_t esdm_parallel_bytes;
+
+// Set in case vectorized elementary functions (exp, log, sin, ...) trade accuracy for speed
+extern int esdm_math_fast;
+
+#endif				//__ESDM_KERNELS_INTERNAL_H
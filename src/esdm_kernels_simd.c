@@ -0,0 +1,944 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+    Vectorized reduction kernels and elementary functions.
+
+    Each vector lane keeps its own partial result: comparisons are evaluated
+    on the native type, whereas sums are accumulated in double-precision lanes.
+    Missing elements (equal to the fill value, or NaN in case the fill value
+    is NaN) are masked out instead of being skipped.
+    Since sums are evaluated in a different order, floating-point results may
+    differ from the scalar kernels by a few units in the last place, whereas
+    sums of integer elements are exact as long as they are below 2^53. As done
+    by the scalar kernels, NaN values are skipped by max/min.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esdm_kernels_internal.h"
+
+// This file is built once for each instruction set; the name of the kernel table depends on it
+#ifndef ESDM_SIMD_ISA
+#define ESDM_SIMD_ISA generic
+#endif
+#define ESDM_SIMD_TABLE_NAME(ISA) esdm_simd_kernels_##ISA
+#define ESDM_SIMD_TABLE(ISA) ESDM_SIMD_TABLE_NAME(ISA)
+
+#if defined(__AVX512F__)
+#define ESDM_SIMD_BYTES 64
+#elif defined(__AVX2__)
+#define ESDM_SIMD_BYTES 32
+#else
+#define ESDM_SIMD_BYTES 16
+#endif
+
+// Number of elements per accumulation step, one per double-precision lane
+#define ESDM_SIMD_WIDE (ESDM_SIMD_BYTES / sizeof(double))
+
+// Number of steps after which narrow counters have to be flushed to avoid overflows
+#define ESDM_SIMD_FLUSH(MASK) (sizeof(MASK) < sizeof(int) ? (1ULL << (8 * sizeof(MASK) - 1)) - 1 : 1ULL << 30)
+
+// Check whether the values of the type of X are exactly represented in double precision
+#define ESDM_SIMD_EXACT(X) ((sizeof(X) < sizeof(double)) || ((__typeof__(X)) 0.5 != 0))
+
+#define ESDM_SIMD_LOAD(V, P) __builtin_memcpy(&(V), (P), sizeof(V))
+
+// Mask of the valid lanes of X for a given fill mode
+#define ESDM_SIMD_VALID(MODE, X, FV) ((MODE) == ESDM_FILL_NAN ? (X) == (X) : (X) != (FV))
+
+// Select the lanes of A where M is set and the lanes of B elsewhere
+#define ESDM_SIMD_SELECT(VT, MT, M, A, B) ((VT) (((MT) (A) & (M)) | ((MT) (B) & ~(M))))
+
+typedef double esdm_simd_d __attribute__ ((vector_size(ESDM_SIMD_BYTES)));
+typedef long long esdm_simd_l __attribute__ ((vector_size(ESDM_SIMD_BYTES)));
+
+#define ESDM_SIMD_TYPES(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, ...) \
+typedef TYPE esdm_simd_##TNAME __attribute__ ((vector_size(ESDM_SIMD_BYTES))); \
+typedef MASK esdm_simd_##TNAME##_m __attribute__ ((vector_size(ESDM_SIMD_BYTES))); \
+typedef TYPE esdm_simd_##TNAME##_w __attribute__ ((vector_size(ESDM_SIMD_WIDE * sizeof(TYPE))));
+
+ESDM_FOR_EACH_TYPE(ESDM_SIMD_TYPES, )
+
+// Load ESDM_SIMD_WIDE elements starting from P into the double-precision lanes DD, setting MM to the mask of the valid ones
+#define ESDM_SIMD_LOAD_WIDE(TNAME, P, MODE, FV, DD, MM) { \
+	esdm_simd_##TNAME##_w ww; \
+	ESDM_SIMD_LOAD(ww, P); \
+	DD = __builtin_convertvector(ww, esdm_simd_d); \
+	if ((MODE) != ESDM_FILL_NONE) \
+		/* Values are compared after the conversion, unless it is not exact */ \
+		MM = (MODE) == ESDM_FILL_NAN || ESDM_SIMD_EXACT(FV) ? (esdm_simd_l) ESDM_SIMD_VALID(MODE, DD, (double) (FV)) : __builtin_convertvector(ww != (FV), esdm_simd_l); \
+}
+
+// Add ESDM_SIMD_WIDE elements starting from P to the double-precision lanes S, counting valid elements in C
+#define ESDM_SIMD_ACCUMULATE(TNAME, P, MODE, FV, S, C) { \
+	esdm_simd_d dd; \
+	esdm_simd_l mm; \
+	ESDM_SIMD_LOAD_WIDE(TNAME, P, MODE, FV, dd, mm); \
+	if ((MODE) != ESDM_FILL_NONE) { \
+		dd = (esdm_simd_d) ((esdm_simd_l) dd & mm); \
+		C -= mm; \
+	} \
+	S += dd; \
+}
+
+#define ESDM_SIMD_SUM(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_simd_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	const int fill = (MODE) != ESDM_FILL_NONE; \
+	uint64_t i = 0, j, n = f->n; \
+	esdm_simd_d s1 = { 0 }, t1 = { 0 }; \
+	esdm_simd_l c = { 0 }, c2 = { 0 }; \
+	for (; i + 2 * ESDM_SIMD_WIDE <= n; i += 2 * ESDM_SIMD_WIDE) { \
+		ESDM_SIMD_ACCUMULATE(TNAME, a + i, MODE, fv, s1, c); \
+		ESDM_SIMD_ACCUMULATE(TNAME, a + i + ESDM_SIMD_WIDE, MODE, fv, t1, c2); \
+	} \
+	s1 += t1; \
+	c += c2; \
+	tmp->value1 = 0; \
+	tmp->number = fill ? 0 : i; \
+	for (j = 0; j < ESDM_SIMD_WIDE; ++j) { \
+		tmp->value1 += s1[j]; \
+		if (fill) \
+			tmp->number += c[j]; \
+	} \
+	for (; i < n; ++i) \
+		if (ESDM_IS_VALID(MODE, a[i], fv)) { \
+			tmp->value1 += a[i]; \
+			tmp->number++; \
+		} \
+}
+
+ESDM_FOR_EACH_KERNEL(ESDM_SIMD_SUM, sum)
+
+// Number of steps of a block of per-lane moments
+#define ESDM_SIMD_BLOCK 64
+
+// Per-lane moments: elements are accumulated block by block as deviations from a shift, the mean of the lane so far,
+// then the block is merged into the number, the mean and M2 of the lane, as done by esdm_moments_merge; the sum is kept as well,
+// so that sums of integer elements are exact as in the scalar kernels
+typedef struct _esdm_simd_moments_t {
+	esdm_simd_d n;
+	esdm_simd_d sum;
+	esdm_simd_d mean;
+	esdm_simd_d m2;
+	esdm_simd_d shift;
+	esdm_simd_d s1;		// Sum of the deviations of the current block
+	esdm_simd_d s2;		// Sum of their squares
+	esdm_simd_l c;		// Number of valid elements of the current block
+	double steps;		// Number of steps of the current block
+} esdm_simd_moments_t;
+
+// Start the moments, using the first valid element among the N ones starting from P as first shift of every lane
+#define ESDM_SIMD_MOMENTS_INIT(P, N, MODE, FV, M) { \
+	uint64_t k = 0; \
+	memset(&(M), 0, sizeof(esdm_simd_moments_t)); \
+	while ((k < (N)) && !ESDM_IS_VALID(MODE, (P)[k], FV)) \
+		++k; \
+	if (k < (N)) \
+		(M).shift += (double) (P)[k]; \
+}
+
+// Add ESDM_SIMD_WIDE elements starting from P to the current block
+#define ESDM_SIMD_MOMENTS_ADD(TNAME, P, MODE, FV, M) { \
+	esdm_simd_d dd; \
+	esdm_simd_l mm; \
+	ESDM_SIMD_LOAD_WIDE(TNAME, P, MODE, FV, dd, mm); \
+	if ((MODE) != ESDM_FILL_NONE) { \
+		dd = (esdm_simd_d) ((esdm_simd_l) dd & mm); \
+		(M).c -= mm; \
+	} \
+	(M).sum += dd; \
+	dd -= (M).shift; \
+	if ((MODE) != ESDM_FILL_NONE) \
+		dd = (esdm_simd_d) ((esdm_simd_l) dd & mm); \
+	(M).s1 += dd; \
+	(M).s2 += dd * dd; \
+	(M).steps++; \
+}
+
+static inline void esdm_simd_moments_flush(esdm_simd_moments_t * m, int fill)
+{
+	const esdm_simd_d zero = { 0 }, one = zero + 1;
+	esdm_simd_d nb = fill ? __builtin_convertvector(m->c, esdm_simd_d) : zero + m->steps;
+	esdm_simd_d total = m->n + nb;
+	// Lanes without elements are left unchanged, divisions by zero are avoided
+	esdm_simd_d nbs = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, nb > zero, nb, one);
+	esdm_simd_d totals = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, total > zero, total, one);
+	esdm_simd_d delta = m->shift + m->s1 / nbs - m->mean;
+	m->m2 += m->s2 - m->s1 * m->s1 / nbs + delta * delta * m->n * nb / totals;
+	m->mean += delta * nb / totals;
+	m->n = total;
+	m->shift = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, total > zero, m->mean, m->shift);
+	m->s1 = zero;
+	m->s2 = zero;
+	m->c ^= m->c;
+	m->steps = 0;
+}
+
+// Merge the lanes into number, sum and M2
+static inline void esdm_simd_moments_end(esdm_simd_moments_t * m, int fill, uint64_t * n, double *sum, double *m2)
+{
+	uint64_t j;
+	esdm_simd_moments_flush(m, fill);
+	for (j = 0; j < ESDM_SIMD_WIDE; ++j)
+		esdm_moments_merge(n, sum, m2, (uint64_t) m->n[j], m->sum[j], m->m2[j]);
+}
+
+#define ESDM_SIMD_MOMENTS(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_simd_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	const int fill = (MODE) != ESDM_FILL_NONE; \
+	uint64_t i = 0, n = f->n; \
+	esdm_simd_moments_t m1, m2; \
+	tmp->value1 = 0; \
+	tmp->value2 = 0; \
+	tmp->number = 0; \
+	if (n >= 2 * ESDM_SIMD_WIDE) { \
+		ESDM_SIMD_MOMENTS_INIT(a, n, MODE, fv, m1); \
+		m2 = m1; \
+		for (; i + 2 * ESDM_SIMD_WIDE <= n; i += 2 * ESDM_SIMD_WIDE) { \
+			ESDM_SIMD_MOMENTS_ADD(TNAME, a + i, MODE, fv, m1); \
+			ESDM_SIMD_MOMENTS_ADD(TNAME, a + i + ESDM_SIMD_WIDE, MODE, fv, m2); \
+			if (m1.steps == ESDM_SIMD_BLOCK) { \
+				esdm_simd_moments_flush(&m1, fill); \
+				esdm_simd_moments_flush(&m2, fill); \
+			} \
+		} \
+		esdm_simd_moments_end(&m1, fill, &tmp->number, &tmp->value1, &tmp->value2); \
+		esdm_simd_moments_end(&m2, fill, &tmp->number, &tmp->value1, &tmp->value2); \
+	} \
+	for (; i < n; ++i) \
+		if (ESDM_IS_VALID(MODE, a[i], fv)) \
+			esdm_moments_add(tmp->number++, &tmp->value1, &tmp->value2, a[i]); \
+}
+
+ESDM_FOR_EACH_KERNEL(ESDM_SIMD_MOMENTS, moments)
+
+// Update the lanes of V with the elements of X satisfying V CMP X; invalid lanes are left untouched
+#define ESDM_SIMD_UPDATE(TNAME, V, X, M, FILL, CMP) { \
+	esdm_simd_##TNAME xx = (FILL) ? ESDM_SIMD_SELECT(esdm_simd_##TNAME, esdm_simd_##TNAME##_m, M, X, V) : (X); \
+	esdm_simd_##TNAME##_m u = V CMP xx; \
+	V = ESDM_SIMD_SELECT(esdm_simd_##TNAME, esdm_simd_##TNAME##_m, u, xx, V); \
+}
+
+// Count the lanes where M is set into the narrow counters C, flushing them into the total T when needed
+#define ESDM_SIMD_COUNT(TNAME, MASK, C, M, STEPS, T) { \
+	C -= (M); \
+	if (++STEPS == ESDM_SIMD_FLUSH(MASK)) { \
+		uint64_t jj; \
+		for (jj = 0; jj < ESDM_SIMD_BYTES / sizeof(MASK); ++jj) \
+			T += (uint64_t) C[jj]; \
+		C ^= C; \
+		STEPS = 0; \
+	} \
+}
+
+#define ESDM_SIMD_COUNT_END(MASK, C, T) { \
+	uint64_t jj; \
+	for (jj = 0; jj < ESDM_SIMD_BYTES / sizeof(MASK); ++jj) \
+		T += (uint64_t) C[jj]; \
+}
+
+#define ESDM_SIMD_EXTREME(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP, CMP, FROM_LOWEST) \
+static void esdm_simd_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	UNUSED(plan); \
+	const size_t lanes = ESDM_SIMD_BYTES / sizeof(TYPE); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE v, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0; \
+	const int fill = (MODE) != ESDM_FILL_NONE; \
+	uint64_t i = 0, j, n = f->n, steps = 0; \
+	esdm_simd_##TNAME vv = (esdm_simd_##TNAME) { 0 } + (TYPE) ((FROM_LOWEST) ? (LOWEST) : (HIGHEST)), x; \
+	esdm_simd_##TNAME##_m c = { 0 }, m = { 0 }; \
+	tmp->number = 0; \
+	for (; i + lanes <= n; i += lanes) { \
+		ESDM_SIMD_LOAD(x, a + i); \
+		if (fill) { \
+			m = ESDM_SIMD_VALID(MODE, x, fv); \
+			ESDM_SIMD_COUNT(TNAME, MASK, c, m, steps, tmp->number); \
+		} \
+		ESDM_SIMD_UPDATE(TNAME, vv, x, m, fill, CMP); \
+	} \
+	if (fill) \
+		ESDM_SIMD_COUNT_END(MASK, c, tmp->number) \
+	else \
+		tmp->number = i; \
+	v = vv[0]; \
+	for (j = 1; j < lanes; ++j) \
+		if (v CMP vv[j]) \
+			v = vv[j]; \
+	if (ESDM_IS_FLOATING(TYPE) && tmp->number && (v == (TYPE) ((FROM_LOWEST) ? (LOWEST) : (HIGHEST)))) { \
+		/* Lanes keep their initial value in case all the valid elements are NaN, which are not counted then */ \
+		for (j = 0; (j < i) && !(ESDM_IS_VALID(MODE, a[j], fv) && (a[j] == a[j])); ++j); \
+		if (j == i) \
+			tmp->number = 0; \
+	} \
+	for (; i < n; ++i) \
+		if (ESDM_IS_VALID(MODE, a[i], fv) && (a[i] == a[i]) && (!tmp->number || (v CMP a[i]))) { \
+			v = a[i]; \
+			tmp->number++; \
+		} \
+	tmp->value1 = v; \
+}
+
+ESDM_FOR_EACH_KERNEL(ESDM_SIMD_EXTREME, max, <, 1)
+ESDM_FOR_EACH_KERNEL(ESDM_SIMD_EXTREME, min, >, 0)
+
+#define ESDM_SIMD_STAT(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_simd_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const size_t lanes = ESDM_SIMD_BYTES / sizeof(TYPE); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE v1, v2, fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, t = (TYPE) plan->SCALAR; \
+	const int fill = (MODE) != ESDM_FILL_NONE; \
+	int option = plan->option, less = plan->thresh_type == ESDM_FUNCTION_OP_LESS_THAN; \
+	int outlier = (option & ESDM_STAT_BIT(ESDM_STAT_OUTLIER)) && plan->has_scalar; \
+	uint64_t i = 0, j, n = f->n, steps = 0, osteps = 0; \
+	esdm_simd_##TNAME vmin = (esdm_simd_##TNAME) { 0 } + (TYPE) (HIGHEST), vmax = (esdm_simd_##TNAME) { 0 } + (TYPE) (LOWEST), x; \
+	esdm_simd_##TNAME##_m c = { 0 }, oc = { 0 }, m = { 0 }, o; \
+	uint64_t number = 0; \
+	esdm_simd_moments_t moments; \
+	memset(tmp, 0, sizeof(esdm_stream_data_out_t)); \
+	if (!option)	/* No operation is executed in this case */ \
+		return; \
+	if (n >= lanes) \
+		ESDM_SIMD_MOMENTS_INIT(a, n, MODE, fv, moments); \
+	for (; i + lanes <= n; i += lanes) { \
+		ESDM_SIMD_LOAD(x, a + i); \
+		if (fill) { \
+			m = ESDM_SIMD_VALID(MODE, x, fv); \
+			ESDM_SIMD_COUNT(TNAME, MASK, c, m, steps, tmp->number); \
+		} \
+		if (option & ESDM_STAT_BIT(ESDM_STAT_MIN)) \
+			ESDM_SIMD_UPDATE(TNAME, vmin, x, m, fill, >); \
+		if (option & ESDM_STAT_BIT(ESDM_STAT_MAX)) \
+			ESDM_SIMD_UPDATE(TNAME, vmax, x, m, fill, <); \
+		if (option & ESDM_STAT_SUMS) { \
+			for (j = 0; j < lanes; j += ESDM_SIMD_WIDE) \
+				ESDM_SIMD_MOMENTS_ADD(TNAME, a + i + j, MODE, fv, moments); \
+			if (moments.steps >= ESDM_SIMD_BLOCK) \
+				esdm_simd_moments_flush(&moments, fill); \
+		} \
+		if (outlier) { \
+			o = less ? x < t : x > t; \
+			if (fill) \
+				o &= m; \
+			ESDM_SIMD_COUNT(TNAME, MASK, oc, o, osteps, tmp->outlier); \
+		} \
+	} \
+	if (fill) \
+		ESDM_SIMD_COUNT_END(MASK, c, tmp->number) \
+	else \
+		tmp->number = i; \
+	ESDM_SIMD_COUNT_END(MASK, oc, tmp->outlier); \
+	v1 = vmin[0]; \
+	v2 = vmax[0]; \
+	for (j = 1; j < lanes; ++j) { \
+		if (v1 > vmin[j]) \
+			v1 = vmin[j]; \
+		if (v2 < vmax[j]) \
+			v2 = vmax[j]; \
+	} \
+	if ((option & ESDM_STAT_SUMS) && (n >= lanes)) \
+		esdm_simd_moments_end(&moments, fill, &number, &tmp->value3, &tmp->value4); \
+	for (; i < n; ++i) \
+		if (ESDM_IS_VALID(MODE, a[i], fv)) { \
+			if ((option & ESDM_STAT_BIT(ESDM_STAT_MIN)) && (v1 > a[i])) \
+				v1 = a[i]; \
+			if ((option & ESDM_STAT_BIT(ESDM_STAT_MAX)) && (v2 < a[i])) \
+				v2 = a[i]; \
+			if (option & ESDM_STAT_SUMS) \
+				esdm_moments_add(tmp->number, &tmp->value3, &tmp->value4, a[i]); \
+			if (outlier && (less ? t > a[i] : t < a[i])) \
+				tmp->outlier++; \
+			tmp->number++; \
+		} \
+	tmp->value1 = tmp->number ? v1 : 0; \
+	tmp->value2 = tmp->number ? v2 : 0; \
+	tmp->missing = n - tmp->number; \
+}
+
+ESDM_FOR_EACH_KERNEL(ESDM_SIMD_STAT, stat)
+
+#define ESDM_SIMD_OUTLIER(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_simd_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const size_t lanes = ESDM_SIMD_BYTES / sizeof(TYPE); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, v = (TYPE) plan->SCALAR; \
+	const int fill = (MODE) != ESDM_FILL_NONE, less = plan->thresh_type == ESDM_FUNCTION_OP_LESS_THAN; \
+	uint64_t i = 0, n = f->n, steps = 0, count = 0; \
+	esdm_simd_##TNAME x; \
+	esdm_simd_##TNAME##_m c = { 0 }, m; \
+	tmp->value1 = 0; \
+	tmp->number = 1;	/* Use only to avoid errors during the reduction phase */ \
+	if (!plan->has_scalar)	/* No element is considered outlier in case the threshold is not given */ \
+		return; \
+	for (; i + lanes <= n; i += lanes) { \
+		ESDM_SIMD_LOAD(x, a + i); \
+		m = less ? x < v : x > v; \
+		if (fill) \
+			m &= ESDM_SIMD_VALID(MODE, x, fv); \
+		ESDM_SIMD_COUNT(TNAME, MASK, c, m, steps, count); \
+	} \
+	ESDM_SIMD_COUNT_END(MASK, c, count); \
+	for (; i < n; ++i) \
+		if (ESDM_IS_VALID(MODE, a[i], fv) && (less ? v > a[i] : v < a[i])) \
+			count++; \
+	tmp->value1 = count; \
+}
+
+ESDM_FOR_EACH_KERNEL(ESDM_SIMD_OUTLIER, outlier)
+
+// Elementary functions evaluated on whole vectors by polynomial (or rational) approximations, after the argument has been reduced
+// to a small range: double-precision lanes follow fdlibm (within 1 ulp), except for the hyperbolic functions, whereas single-precision
+// lanes follow the Cephes library; the latter are used by the fast mode only, since they may be a few ulps off
+
+// Half of a single-precision vector, converted to double-precision lanes
+typedef float esdm_simd_float_h __attribute__ ((vector_size(ESDM_SIMD_BYTES / 2)));
+
+// Adding this constant rounds a value to the nearest integer, which is then found in the low bits of the sum
+#define ESDM_SIMD_ROUND_D 0x1.8p52
+#define ESDM_SIMD_ROUND_F 0x1.8p23f
+
+// Arguments of sine, cosine and tangent larger than these bounds are reduced by the scalar library
+#define ESDM_SIMD_TRIG_MAX_D 5e8
+#define ESDM_SIMD_TRIG_MAX_F 8192.0f
+
+#define ESDM_SIMD_SPLAT(VT, X) ((VT) { 0 } + (X))
+
+// Check whether any lane of a mask is set
+#define ESDM_SIMD_ANY(M, ANY) { \
+	size_t jj; \
+	ANY = 0; \
+	for (jj = 0; jj < sizeof(M) / sizeof(M[0]); ++jj) \
+		ANY |= M[jj] != 0; \
+}
+
+// Evaluate F by the scalar library on the lanes of X selected by M
+#define ESDM_SIMD_SCALAR(Y, X, M, F) { \
+	size_t jj; \
+	for (jj = 0; jj < sizeof(M) / sizeof(M[0]); ++jj) \
+		if (M[jj]) \
+			Y[jj] = F(X[jj]); \
+}
+
+// Multiply x by 2^k in two steps, so that also subnormal results are obtained
+static inline esdm_simd_d esdm_simd_ldexp_d(esdm_simd_d x, esdm_simd_l k)
+{
+	esdm_simd_l h = k >> 1;
+	return x * (esdm_simd_d) ((h + 1023) << 52) * (esdm_simd_d) ((k - h + 1023) << 52);
+}
+
+static inline esdm_simd_float esdm_simd_ldexp_f(esdm_simd_float x, esdm_simd_float_m k)
+{
+	esdm_simd_float_m h = k >> 1;
+	return x * (esdm_simd_float) ((h + 127) << 23) * (esdm_simd_float) ((k - h + 127) << 23);
+}
+
+static esdm_simd_d esdm_simd_exp_d(esdm_simd_d x)
+{
+	const esdm_simd_l over = x > 7.09782712893383973096e2, under = x < -7.45133219101941108420e2;
+	esdm_simd_d n, hi, lo, r, rr, c;
+	esdm_simd_l k;
+	x = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, over | under, ESDM_SIMD_SPLAT(esdm_simd_d, 0.0), x);
+	// exp(x) = 2^k * exp(r), where r = hi - lo and |r| <= log(2) / 2
+	n = x * M_LOG2E + ESDM_SIMD_ROUND_D;
+	k = (esdm_simd_l) n - (esdm_simd_l) ESDM_SIMD_SPLAT(esdm_simd_d, ESDM_SIMD_ROUND_D);
+	n -= ESDM_SIMD_ROUND_D;
+	hi = x - n * 6.93147180369123816490e-01;
+	lo = n * 1.90821492927058770002e-10;
+	r = hi - lo;
+	rr = r * r;
+	c = r - rr * (1.66666666666666019037e-01 + rr * (-2.77777777770155933842e-03 + rr * (6.61375632143793436117e-05
+									       + rr * (-1.65339022054652515390e-06 + rr * 4.13813679705723846039e-08))));
+	r = esdm_simd_ldexp_d(1.0 - ((lo - (r * c) / (2.0 - c)) - hi), k);
+	r = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, over, ESDM_SIMD_SPLAT(esdm_simd_d, INFINITY), r);
+	return ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, under, ESDM_SIMD_SPLAT(esdm_simd_d, 0.0), r);
+}
+
+static esdm_simd_float esdm_simd_exp_f(esdm_simd_float x)
+{
+	const esdm_simd_float_m over = x > 88.72283905206835f, under = x < -103.972077083991796f;
+	esdm_simd_float n, r;
+	esdm_simd_float_m k;
+	x = ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, over | under, ESDM_SIMD_SPLAT(esdm_simd_float, 0.0f), x);
+	n = x * 1.44269504088896341f + ESDM_SIMD_ROUND_F;
+	k = (esdm_simd_float_m) n - (esdm_simd_float_m) ESDM_SIMD_SPLAT(esdm_simd_float, ESDM_SIMD_ROUND_F);
+	n -= ESDM_SIMD_ROUND_F;
+	r = x - n * 0.693359375f + n * 2.12194440e-4f;
+	r = (((((1.9875691500E-4f * r + 1.3981999507E-3f) * r + 8.3334519073E-3f) * r + 4.1665795894E-2f) * r + 1.6666665459E-1f) * r + 5.0000001201E-1f) * r * r + r + 1.0f;
+	r = esdm_simd_ldexp_f(r, k);
+	r = ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, over, ESDM_SIMD_SPLAT(esdm_simd_float, INFINITY), r);
+	return ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, under, ESDM_SIMD_SPLAT(esdm_simd_float, 0.0f), r);
+}
+
+// Logarithms of non-positive values and NaN
+#define ESDM_SIMD_LOG_SPECIAL(VT, MT, X, Y) { \
+	Y = ESDM_SIMD_SELECT(VT, MT, X == INFINITY, X, Y); \
+	Y = ESDM_SIMD_SELECT(VT, MT, X == 0, ESDM_SIMD_SPLAT(VT, -INFINITY), Y); \
+	Y = ESDM_SIMD_SELECT(VT, MT, (X < 0) | (X != X), ESDM_SIMD_SPLAT(VT, NAN), Y); \
+}
+
+// Reduce x to 2^k * (1 + f), where 1 + f is in [sqrt(2) / 2, sqrt(2)), so that log(1 + f) = f - hfsq + t, and return t
+static inline esdm_simd_d esdm_simd_log_reduce_d(esdm_simd_d x, esdm_simd_d * k, esdm_simd_d * f, esdm_simd_d * hfsq)
+{
+	const esdm_simd_l tiny = x < 2.2250738585072014e-308;
+	esdm_simd_l bits, e, big;
+	esdm_simd_d m, s, z, w;
+	x = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, tiny, x * 0x1p54, x);
+	bits = (esdm_simd_l) x;
+	e = (bits >> 52) - 1023 - (tiny & 54);
+	m = (esdm_simd_d) ((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+	big = m > M_SQRT2;
+	m = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, big, m * 0.5, m);
+	*k = __builtin_convertvector(e - big, esdm_simd_d);
+	*f = m - 1.0;
+	s = *f / (2.0 + *f);
+	z = s * s;
+	w = z * z;
+	*hfsq = 0.5 * *f * *f;
+	w = z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)))
+	    + w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+	return s * (*hfsq + w);
+}
+
+static esdm_simd_d esdm_simd_log_d(esdm_simd_d x)
+{
+	esdm_simd_d k, f, hfsq, t, y;
+	t = esdm_simd_log_reduce_d(x, &k, &f, &hfsq);
+	y = k * 6.93147180369123816490e-01 - ((hfsq - (t + k * 1.90821492927058770002e-10)) - f);
+	ESDM_SIMD_LOG_SPECIAL(esdm_simd_d, esdm_simd_l, x, y);
+	return y;
+}
+
+static esdm_simd_d esdm_simd_log10_d(esdm_simd_d x)
+{
+	esdm_simd_d k, f, hfsq, t, y, hi, lo, vhi, vlo, w;
+	t = esdm_simd_log_reduce_d(x, &k, &f, &hfsq);
+	// f - hfsq is split into hi + lo, so that hi can be multiplied exactly by the leading bits of 1 / log(10)
+	hi = (esdm_simd_d) ((esdm_simd_l) (f - hfsq) & (long long) 0xffffffff00000000ULL);
+	lo = (f - hi) - hfsq + t;
+	vhi = hi * 4.34294481878168880939e-01;
+	vlo = k * 3.69423907715893078616e-13 + (lo + hi) * 2.50829467116452752298e-11 + lo * 4.34294481878168880939e-01;
+	w = k * 3.01029995663611771306e-01 + vhi;
+	vlo += (k * 3.01029995663611771306e-01 - w) + vhi;
+	y = vlo + w;
+	ESDM_SIMD_LOG_SPECIAL(esdm_simd_d, esdm_simd_l, x, y);
+	return y;
+}
+
+// Reduce x to 2^e * m, where m is in [sqrt(2) / 2, sqrt(2)), and return log(m) - (m - 1) without the term in e
+static inline esdm_simd_float esdm_simd_log_reduce_f(esdm_simd_float x, esdm_simd_float * e, esdm_simd_float * m)
+{
+	const esdm_simd_float_m tiny = x < 1.17549435e-38f;
+	esdm_simd_float_m bits, k, small;
+	esdm_simd_float z;
+	x = ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, tiny, x * 0x1p25f, x);
+	bits = (esdm_simd_float_m) x;
+	k = (bits >> 23) - 126 - (tiny & 25);
+	*m = (esdm_simd_float) ((bits & 0x007fffff) | 0x3f000000);
+	small = *m < 0.707106781186547524f;
+	*e = __builtin_convertvector(k + small, esdm_simd_float);
+	*m = ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, small, *m + *m, *m) - 1.0f;
+	z = *m * *m;
+	return ((((((((7.0376836292E-2f * *m - 1.1514610310E-1f) * *m + 1.1676998740E-1f) * *m - 1.2420140846E-1f) * *m + 1.4249322787E-1f) * *m
+		   - 1.6668057665E-1f) * *m + 2.0000714765E-1f) * *m - 2.4999993993E-1f) * *m + 3.3333331174E-1f) * *m * z - 0.5f * z;
+}
+
+static esdm_simd_float esdm_simd_log_f(esdm_simd_float x)
+{
+	esdm_simd_float e, m, y;
+	y = esdm_simd_log_reduce_f(x, &e, &m);
+	y = (m + (y - 2.12194440e-4f * e)) + 0.693359375f * e;
+	ESDM_SIMD_LOG_SPECIAL(esdm_simd_float, esdm_simd_float_m, x, y);
+	return y;
+}
+
+static esdm_simd_float esdm_simd_log10_f(esdm_simd_float x)
+{
+	esdm_simd_float e, m, y, z;
+	y = esdm_simd_log_reduce_f(x, &e, &m);
+	z = (m + y) * 7.00731903251827651129E-4f;
+	z += y * 4.3359375E-1f;
+	z += m * 4.3359375E-1f;
+	z += e * 2.48745663981195213739E-4f;
+	y = z + e * 3.0078125E-1f;
+	ESDM_SIMD_LOG_SPECIAL(esdm_simd_float, esdm_simd_float_m, x, y);
+	return y;
+}
+
+// Reduce x to z + t = x - q * pi / 2, where |z| <= pi / 4 and t is the rounding error of z, returning the quadrant q:
+// the first three parts of pi / 2 have 24 bits, so that their products by q are exact, while the rounding errors of the last two
+// subtractions are collected into t, which keeps the result accurate close to the multiples of pi / 2
+static inline esdm_simd_l esdm_simd_trig_reduce_d(esdm_simd_d x, esdm_simd_d * z, esdm_simd_d * t)
+{
+	esdm_simd_d q = x * M_2_PI + ESDM_SIMD_ROUND_D, y, e;
+	esdm_simd_l k = (esdm_simd_l) q - (esdm_simd_l) ESDM_SIMD_SPLAT(esdm_simd_d, ESDM_SIMD_ROUND_D);
+	q -= ESDM_SIMD_ROUND_D;
+	y = (x - q * 1.57079625129699707031E0) - q * 7.54978941586159635336E-8;
+	e = y - q * 5.39030295347423839269E-15;
+	*t = (y - e) - q * 5.39030295347423839269E-15;
+	*z = e - q * -9.53161193398001103352E-23;
+	*t += (e - *z) - q * -9.53161193398001103352E-23;
+	return k;
+}
+
+static inline esdm_simd_float_m esdm_simd_trig_reduce_f(esdm_simd_float x, esdm_simd_float * z)
+{
+	esdm_simd_float q = x * 0.636619772367581343f + ESDM_SIMD_ROUND_F;
+	esdm_simd_float_m k = (esdm_simd_float_m) q - (esdm_simd_float_m) ESDM_SIMD_SPLAT(esdm_simd_float, ESDM_SIMD_ROUND_F);
+	q -= ESDM_SIMD_ROUND_F;
+	*z = ((x - q * 1.5703125f) - q * 4.837512969970703125e-4f) - q * 7.54978995489188216e-8f;
+	return k;
+}
+
+// Sine, or cosine in case cosine is set, since cos(x) = sin(x + pi / 2)
+static esdm_simd_d esdm_simd_sincos_d(esdm_simd_d x, int cosine)
+{
+	esdm_simd_d z, t, zz, w, r, v, s, c, y;
+	esdm_simd_l k = esdm_simd_trig_reduce_d(x, &z, &t) + cosine, large = (x > ESDM_SIMD_TRIG_MAX_D) | (x < -ESDM_SIMD_TRIG_MAX_D);
+	int any;
+	zz = z * z;
+	w = zz * zz;
+	r = 8.33333333332248946124e-03 + zz * (-1.98412698298579493134e-04 + zz * 2.75573137070700676789e-06)
+	    + zz * w * (-2.50507602534068634195e-08 + zz * 1.58969099521155010221e-10);
+	v = zz * z;
+	s = z - ((zz * (0.5 * t - v * r) - t) - v * -1.66666666666666324348e-01);
+	r = zz * (4.16666666666666019037e-02 + zz * (-1.38888888888741095749e-03 + zz * 2.48015872894767294178e-05))
+	    + w * w * (-2.75573143513906633035e-07 + zz * (2.08757232129817482790e-09 + zz * -1.13596475577881948265e-11));
+	v = 0.5 * zz;
+	w = 1.0 - v;
+	c = w + (((1.0 - w) - v) + (zz * r - z * t));
+	y = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, (k & 1) != 0, c, s);
+	y = (esdm_simd_d) ((esdm_simd_l) y ^ ((k & 2) << 62));
+	ESDM_SIMD_ANY(large, any);
+	if (any) {
+		if (cosine)
+			ESDM_SIMD_SCALAR(y, x, large, cos)
+		else
+			ESDM_SIMD_SCALAR(y, x, large, sin)
+	}
+	return y;
+}
+
+static esdm_simd_float esdm_simd_sincos_f(esdm_simd_float x, int cosine)
+{
+	esdm_simd_float z, zz, s, c, y;
+	esdm_simd_float_m k = esdm_simd_trig_reduce_f(x, &z) + cosine, large = (x > ESDM_SIMD_TRIG_MAX_F) | (x < -ESDM_SIMD_TRIG_MAX_F);
+	int any;
+	zz = z * z;
+	s = ((-1.9515295891E-4f * zz + 8.3321608736E-3f) * zz - 1.6666654611E-1f) * zz * z + z;
+	c = ((2.443315711809948E-5f * zz - 1.388731625493765E-3f) * zz + 4.166664568298827E-2f) * zz * zz - 0.5f * zz + 1.0f;
+	y = ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, (k & 1) != 0, c, s);
+	y = (esdm_simd_float) ((esdm_simd_float_m) y ^ ((k & 2) << 30));
+	ESDM_SIMD_ANY(large, any);
+	if (any) {
+		if (cosine)
+			ESDM_SIMD_SCALAR(y, x, large, cos)
+		else
+			ESDM_SIMD_SCALAR(y, x, large, sin)
+	}
+	return y;
+}
+
+// Tangent, or minus its reciprocal in odd quadrants; close to pi / 4, tan(pi / 4 - x) is evaluated instead
+static esdm_simd_d esdm_simd_tan_d(esdm_simd_d x)
+{
+	esdm_simd_d z, t, zz, w, r, v, s, y, a, u;
+	esdm_simd_l k = esdm_simd_trig_reduce_d(x, &z, &t), large = (x > ESDM_SIMD_TRIG_MAX_D) | (x < -ESDM_SIMD_TRIG_MAX_D);
+	esdm_simd_l sign = (esdm_simd_l) z & LLONG_MIN, big, odd = (k & 1) != 0;
+	int any;
+	big = (esdm_simd_d) ((esdm_simd_l) z ^ sign) >= 0.6744;
+	z = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, big, (7.85398163397448278999e-01 - (esdm_simd_d) ((esdm_simd_l) z ^ sign))
+			     + (3.06161699786838301793e-17 - (esdm_simd_d) ((esdm_simd_l) t ^ sign)), z);
+	t = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, big, ESDM_SIMD_SPLAT(esdm_simd_d, 0.0), t);
+	zz = z * z;
+	w = zz * zz;
+	r = 1.33333333333201242699e-01 + w * (2.18694882948595424599e-02 + w * (3.59207910759131235356e-03 + w * (5.88041240820264096874e-04
+	    + w * (7.81794442939557092300e-05 + w * -1.85586374855275456654e-05))));
+	v = zz * (5.39682539762260521377e-02 + w * (8.86323982359930005737e-03 + w * (1.45620945432529025516e-03 + w * (2.46463134818469906812e-04
+	    + w * (7.14072491382608190305e-05 + w * 2.59073051863633712884e-05)))));
+	s = zz * z;
+	r = t + zz * (s * (r + v) + t);
+	r += 3.33333333333334091986e-01 * s;
+	w = z + r;
+	// Close to pi / 4: v is 1 for the tangent and -1 for minus the reciprocal
+	v = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, odd, ESDM_SIMD_SPLAT(esdm_simd_d, -1.0), ESDM_SIMD_SPLAT(esdm_simd_d, 1.0));
+	u = v - 2.0 * (z - (w * w / (w + v) - r));
+	u = (esdm_simd_d) ((esdm_simd_l) u ^ sign);
+	// Minus the reciprocal of w = z + r, where the leading bits of w and of its reciprocal are split off
+	a = -1.0 / w;
+	s = (esdm_simd_d) ((esdm_simd_l) w & (long long) 0xffffffff00000000ULL);
+	v = r - (s - z);
+	y = (esdm_simd_d) ((esdm_simd_l) a & (long long) 0xffffffff00000000ULL);
+	y = y + a * ((1.0 + y * s) + y * v);
+	y = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, odd, y, w);
+	y = ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, big, u, y);
+	ESDM_SIMD_ANY(large, any);
+	if (any)
+		ESDM_SIMD_SCALAR(y, x, large, tan);
+	return y;
+}
+
+static esdm_simd_float esdm_simd_tan_f(esdm_simd_float x)
+{
+	esdm_simd_float z, zz, y;
+	esdm_simd_float_m k = esdm_simd_trig_reduce_f(x, &z), large = (x > ESDM_SIMD_TRIG_MAX_F) | (x < -ESDM_SIMD_TRIG_MAX_F);
+	int any;
+	zz = z * z;
+	y = (((((9.38540185543E-3f * zz + 3.11992232697E-3f) * zz + 2.44301354525E-2f) * zz + 5.34112807005E-2f) * zz + 1.33387994085E-1f) * zz
+	     + 3.33331568548E-1f) * zz * z + z;
+	y = ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, (k & 1) != 0, -1.0f / y, y);
+	ESDM_SIMD_ANY(large, any);
+	if (any)
+		ESDM_SIMD_SCALAR(y, x, large, tan);
+	return y;
+}
+
+// Hyperbolic functions are evaluated from exp(|x|), except close to 0; exp(|x|) / 2 is evaluated as (exp(|x| / 2) / 2) * exp(|x| / 2)
+// close to the overflow threshold, since the result is still finite
+#define ESDM_SIMD_HYPERBOLIC(SUFFIX, VT, MT, HALF, LARGE, A, E) { \
+	MT large = A > (LARGE); \
+	int any; \
+	E = esdm_simd_exp_##SUFFIX(A); \
+	ESDM_SIMD_ANY(large, any); \
+	if (any) { \
+		VT h = esdm_simd_exp_##SUFFIX(A * (HALF)); \
+		h = (h * (HALF)) * h; \
+		E = ESDM_SIMD_SELECT(VT, MT, large, h, E * (HALF)); \
+	} else \
+		E *= (HALF); \
+}
+
+static esdm_simd_d esdm_simd_sinh_d(esdm_simd_d x)
+{
+	const esdm_simd_l sign = (esdm_simd_l) x & LLONG_MIN;
+	esdm_simd_d a = (esdm_simd_d) ((esdm_simd_l) x ^ sign), z = x * x, e, y;
+	ESDM_SIMD_HYPERBOLIC(d, esdm_simd_d, esdm_simd_l, 0.5, 709.0, a, e);
+	y = (esdm_simd_d) ((esdm_simd_l) (e - 0.25 / e) ^ sign);
+	z = x + x * z * (((-7.89474443963537015605E-1 * z - 1.63725857525983828727E2) * z - 1.15614435765005216044E4) * z - 3.51754964808151394800E5)
+	    / (((z - 2.77711081420602794433E2) * z + 3.61578279834431989373E4) * z - 2.11052978884890840399E6);
+	return ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, a < 1.0, z, y);
+}
+
+static esdm_simd_float esdm_simd_sinh_f(esdm_simd_float x)
+{
+	const esdm_simd_float_m sign = (esdm_simd_float_m) x & INT_MIN;
+	esdm_simd_float a = (esdm_simd_float) ((esdm_simd_float_m) x ^ sign), z = x * x, e, y;
+	ESDM_SIMD_HYPERBOLIC(f, esdm_simd_float, esdm_simd_float_m, 0.5f, 88.0f, a, e);
+	y = (esdm_simd_float) ((esdm_simd_float_m) (e - 0.25f / e) ^ sign);
+	z = ((2.03721912945E-4f * z + 8.33028376239E-3f) * z + 1.66667160211E-1f) * z * x + x;
+	return ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, a < 1.0f, z, y);
+}
+
+static esdm_simd_d esdm_simd_cosh_d(esdm_simd_d x)
+{
+	esdm_simd_d a = (esdm_simd_d) ((esdm_simd_l) x & LLONG_MAX), e;
+	ESDM_SIMD_HYPERBOLIC(d, esdm_simd_d, esdm_simd_l, 0.5, 709.0, a, e);
+	return e + 0.25 / e;
+}
+
+static esdm_simd_float esdm_simd_cosh_f(esdm_simd_float x)
+{
+	esdm_simd_float a = (esdm_simd_float) ((esdm_simd_float_m) x & INT_MAX), e;
+	ESDM_SIMD_HYPERBOLIC(f, esdm_simd_float, esdm_simd_float_m, 0.5f, 88.0f, a, e);
+	return e + 0.25f / e;
+}
+
+static esdm_simd_d esdm_simd_tanh_d(esdm_simd_d x)
+{
+	const esdm_simd_l sign = (esdm_simd_l) x & LLONG_MIN;
+	esdm_simd_d a = (esdm_simd_d) ((esdm_simd_l) x ^ sign), z = x * x, y;
+	y = 1.0 - 2.0 / (esdm_simd_exp_d(a + a) + 1.0);
+	y = (esdm_simd_d) ((esdm_simd_l) y ^ sign);
+	z = x + x * z * ((-9.64399179425052238628E-1 * z - 9.92877231001918586564E1) * z - 1.61468768441708447952E3)
+	    / (((z + 1.12811678491632931402E2) * z + 2.23548839060100448583E3) * z + 4.84406305325125486048E3);
+	return ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, a < 0.625, z, y);
+}
+
+static esdm_simd_float esdm_simd_tanh_f(esdm_simd_float x)
+{
+	const esdm_simd_float_m sign = (esdm_simd_float_m) x & INT_MIN;
+	esdm_simd_float a = (esdm_simd_float) ((esdm_simd_float_m) x ^ sign), z = x * x, y;
+	y = 1.0f - 2.0f / (esdm_simd_exp_f(a + a) + 1.0f);
+	y = (esdm_simd_float) ((esdm_simd_float_m) y ^ sign);
+	z = ((((-5.70498872745E-3f * z + 2.06390887954E-2f) * z - 5.37397155531E-2f) * z + 1.33314422036E-1f) * z - 3.33332819422E-1f) * z * x + x;
+	return ESDM_SIMD_SELECT(esdm_simd_float, esdm_simd_float_m, a < 0.625f, z, y);
+}
+
+// Power to a finite exponent evaluated as exp(y * log(|x|)): negative bases are allowed for integer exponents only.
+// The relative error grows with |y * log(x)|, so double-precision datasets use it in fast mode only
+static esdm_simd_d esdm_simd_pow_d(esdm_simd_d x, double y)
+{
+	const esdm_simd_l sign = (esdm_simd_l) x & LLONG_MIN;
+	esdm_simd_d r;
+	if (y == 0)
+		return ESDM_SIMD_SPLAT(esdm_simd_d, 1.0);
+	r = esdm_simd_exp_d(y * esdm_simd_log_d((esdm_simd_d) ((esdm_simd_l) x ^ sign)));
+	if (y != floor(y))
+		return ESDM_SIMD_SELECT(esdm_simd_d, esdm_simd_l, x < 0, ESDM_SIMD_SPLAT(esdm_simd_d, NAN), r);
+	return (fabs(y) < 0x1p53) && (fmod(y, 2.0) != 0) ? (esdm_simd_d) ((esdm_simd_l) r ^ sign) : r;
+}
+
+// Element-wise operations on floating-point datasets: single-precision elements are evaluated in double-precision lanes
+// unless the fast mode is selected, so that they are usually rounded correctly
+#define ESDM_SIMD_MATH_EVAL(OP, DEXPR, WEXPR, FEXPR) \
+static inline esdm_simd_double esdm_simd_math_##OP##_double(esdm_simd_double x, double y) \
+{ \
+	UNUSED(y); \
+	return DEXPR; \
+} \
+static inline esdm_simd_float esdm_simd_math_##OP##_float(esdm_simd_float x, float y) \
+{ \
+	esdm_simd_float_h h[2]; \
+	esdm_simd_d w; \
+	int k; \
+	UNUSED(y); \
+	if (esdm_math_fast) \
+		return FEXPR; \
+	memcpy(h, &x, sizeof(x)); \
+	for (k = 0; k < 2; ++k) { \
+		w = __builtin_convertvector(h[k], esdm_simd_d); \
+		h[k] = __builtin_convertvector(WEXPR, esdm_simd_float_h); \
+	} \
+	memcpy(&x, h, sizeof(x)); \
+	return x; \
+}
+
+ESDM_SIMD_MATH_EVAL(exp, esdm_simd_exp_d(x), esdm_simd_exp_d(w), esdm_simd_exp_f(x))
+ESDM_SIMD_MATH_EVAL(log, esdm_simd_log_d(x), esdm_simd_log_d(w), esdm_simd_log_f(x))
+ESDM_SIMD_MATH_EVAL(log10, esdm_simd_log10_d(x), esdm_simd_log10_d(w), esdm_simd_log10_f(x))
+ESDM_SIMD_MATH_EVAL(sin, esdm_simd_sincos_d(x, 0), esdm_simd_sincos_d(w, 0), esdm_simd_sincos_f(x, 0))
+ESDM_SIMD_MATH_EVAL(cos, esdm_simd_sincos_d(x, 1), esdm_simd_sincos_d(w, 1), esdm_simd_sincos_f(x, 1))
+ESDM_SIMD_MATH_EVAL(tan, esdm_simd_tan_d(x), esdm_simd_tan_d(w), esdm_simd_tan_f(x))
+ESDM_SIMD_MATH_EVAL(sinh, esdm_simd_sinh_d(x), esdm_simd_sinh_d(w), esdm_simd_sinh_f(x))
+ESDM_SIMD_MATH_EVAL(cosh, esdm_simd_cosh_d(x), esdm_simd_cosh_d(w), esdm_simd_cosh_f(x))
+ESDM_SIMD_MATH_EVAL(tanh, esdm_simd_tanh_d(x), esdm_simd_tanh_d(w), esdm_simd_tanh_f(x))
+
+// Powers of double-precision elements are evaluated by the scalar library unless the fast mode is selected
+static inline esdm_simd_double esdm_simd_math_pow_double(esdm_simd_double x, double y)
+{
+	size_t j;
+	if (esdm_math_fast && isfinite(y))
+		return esdm_simd_pow_d(x, y);
+	for (j = 0; j < sizeof(x) / sizeof(x[0]); ++j)
+		x[j] = pow(x[j], y);
+	return x;
+}
+
+// Powers of single-precision elements are evaluated by the scalar library as well unless the fast mode is selected,
+// where they are evaluated in double-precision lanes
+static inline esdm_simd_float esdm_simd_math_pow_float(esdm_simd_float x, float y)
+{
+	esdm_simd_float_h h[2];
+	size_t j;
+	int k;
+	if (!esdm_math_fast || !isfinite(y)) {
+		for (j = 0; j < sizeof(x) / sizeof(x[0]); ++j)
+			x[j] = pow(x[j], y);
+		return x;
+	}
+	memcpy(h, &x, sizeof(x));
+	for (k = 0; k < 2; ++k)
+		h[k] = __builtin_convertvector(esdm_simd_pow_d(__builtin_convertvector(h[k], esdm_simd_d), y), esdm_simd_float_h);
+	memcpy(&x, h, sizeof(x));
+	return x;
+}
+
+// Missing elements are set to the fill value
+#define ESDM_SIMD_MATH_STEP(TNAME, OP, MODE, X, Y, FV, SCALAR) { \
+	Y = esdm_simd_math_##OP##_##TNAME(X, SCALAR); \
+	if ((MODE) != ESDM_FILL_NONE) \
+		Y = ESDM_SIMD_SELECT(esdm_simd_##TNAME, esdm_simd_##TNAME##_m, ESDM_SIMD_VALID(MODE, X, FV), Y, ESDM_SIMD_SPLAT(esdm_simd_##TNAME, FV)); \
+}
+
+// The last elements are evaluated as a whole vector too, so that the result does not depend on the position of an element
+#define ESDM_SIMD_MATH(TNAME, TYPE, SCALAR, MASK, LOWEST, HIGHEST, MNAME, MODE, OP) \
+static void esdm_simd_##OP##_##TNAME##_##MNAME(const esdm_stream_plan_t *plan, const esdm_fragment_t *f, esdm_stream_data_out_t *tmp) \
+{ \
+	const size_t lanes = ESDM_SIMD_BYTES / sizeof(TYPE); \
+	const TYPE *a = (const TYPE *) f->in; \
+	TYPE fv = f->fill_value ? *(const TYPE *) f->fill_value : 0, scalar = (TYPE) plan->SCALAR, v = 0; \
+	char *out = (char *) f->out; \
+	uint64_t i = 0, n = f->n; \
+	esdm_simd_##TNAME x = { 0 }, y; \
+	for (; i + lanes <= n; i += lanes) { \
+		ESDM_SIMD_LOAD(x, a + i); \
+		ESDM_SIMD_MATH_STEP(TNAME, OP, MODE, x, y, fv, scalar); \
+		memcpy(out + i * sizeof(TYPE), &y, sizeof(y)); \
+	} \
+	if (i < n) { \
+		memcpy(&x, a + i, (n - i) * sizeof(TYPE)); \
+		ESDM_SIMD_MATH_STEP(TNAME, OP, MODE, x, y, fv, scalar); \
+		memcpy(out + i * sizeof(TYPE), &y, (n - i) * sizeof(TYPE)); \
+	} \
+	if (n) \
+		memcpy(&v, out + (n - 1) * sizeof(TYPE), sizeof(v)); \
+	tmp->value1 = v; \
+	tmp->number = 1; \
+}
+
+// Generate a kernel for each fill mode of the floating-point types
+#define ESDM_FOR_EACH_REAL_KERNEL(KERNEL, ...) \
+	ESDM_FOR_EACH_MODE(float, float, dscalar, int, -INFINITY, INFINITY, KERNEL, __VA_ARGS__) \
+	ESDM_FOR_EACH_MODE(double, double, dscalar, long long, -INFINITY, INFINITY, KERNEL, __VA_ARGS__)
+
+#define ESDM_SIMD_MATH_ROW(OP) { \
+	[ESDM_TYPE_FLOAT] = { esdm_simd_##OP##_float_none, esdm_simd_##OP##_float_value, esdm_simd_##OP##_float_nan }, \
+	[ESDM_TYPE_DOUBLE] = { esdm_simd_##OP##_double_none, esdm_simd_##OP##_double_value, esdm_simd_##OP##_double_nan } }
+
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, exp)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, log)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, log10)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, sin)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, cos)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, tan)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, sinh)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, cosh)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, tanh)
+ESDM_FOR_EACH_REAL_KERNEL(ESDM_SIMD_MATH, pow)
+
+const esdm_kernel_row_t ESDM_SIMD_TABLE(ESDM_SIMD_ISA)[ESDM_OP_N] = {
+	[ESDM_OP_MAX] = ESDM_KERNEL_ROW(esdm_simd, max),
+	[ESDM_OP_MIN] = ESDM_KERNEL_ROW(esdm_simd, min),
+	[ESDM_OP_AVG] = ESDM_KERNEL_ROW(esdm_simd, sum),
+	[ESDM_OP_SUM] = ESDM_KERNEL_ROW(esdm_simd, sum),
+	[ESDM_OP_STD] = ESDM_KERNEL_ROW(esdm_simd, moments),
+	[ESDM_OP_VAR] = ESDM_KERNEL_ROW(esdm_simd, moments),
+	[ESDM_OP_STAT] = ESDM_KERNEL_ROW(esdm_simd, stat),
+	[ESDM_OP_OUTLIER] = ESDM_KERNEL_ROW(esdm_simd, outlier),
+	[ESDM_OP_POW] = ESDM_SIMD_MATH_ROW(pow),
+	[ESDM_OP_EXP] = ESDM_SIMD_MATH_ROW(exp),
+	[ESDM_OP_LOG] = ESDM_SIMD_MATH_ROW(log),
+	[ESDM_OP_LOG10] = ESDM_SIMD_MATH_ROW(log10),
+	[ESDM_OP_SIN] = ESDM_SIMD_MATH_ROW(sin),
+	[ESDM_OP_COS] = ESDM_SIMD_MATH_ROW(cos),
+	[ESDM_OP_TAN] = ESDM_SIMD_MATH_ROW(tan),
+	[ESDM_OP_SINH] = ESDM_SIMD_MATH_ROW(sinh),
+	[ESDM_OP_COSH] = ESDM_SIMD_MATH_ROW(cosh),
+	[ESDM_OP_TANH] = ESDM_SIMD_MATH_ROW(tanh),
+};
@@ -0,0 +1,242 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esdm_kernels_internal.h"
+
+// Ratio between the capacities of two consecutive levels and minimum capacity of a level
+#define ESDM_SKETCH_DECAY (2.0 / 3.0)
+#define ESDM_SKETCH_WIDTH_MIN 8
+
+typedef struct _esdm_sketch_rank_t {
+	double value;
+	uint64_t weight;
+} esdm_sketch_rank_t;
+
+// The capacities of the levels sum up to less than 3 * k + (ESDM_SKETCH_WIDTH_MIN + 1) * ESDM_SKETCH_LEVELS items,
+// and merging two sketches stores at most twice this number of items before compacting
+static uint32_t esdm_sketch_max_items(uint32_t k)
+{
+	return 2 * (3 * k + (ESDM_SKETCH_WIDTH_MIN + 1) * ESDM_SKETCH_LEVELS);
+}
+
+size_t esdm_sketch_bytes(uint32_t k)
+{
+	return sizeof(esdm_sketch_t) + esdm_sketch_max_items(k) * sizeof(double);
+}
+
+// Capacities of the levels decrease geometrically with the distance from the highest level
+static void esdm_sketch_grow(esdm_sketch_t * sketch)
+{
+	uint32_t h;
+	if (sketch->levels >= ESDM_SKETCH_LEVELS)
+		return;
+	sketch->levels++;
+	for (h = 0, sketch->limit = 0; h < sketch->levels; ++h) {
+		sketch->width[h] = (uint32_t) ceil(sketch->k * pow(ESDM_SKETCH_DECAY, sketch->levels - 1 - h));
+		sketch->width[h] = sketch->width[h] > ESDM_SKETCH_WIDTH_MIN ? sketch->width[h] : ESDM_SKETCH_WIDTH_MIN;
+		sketch->limit += sketch->width[h];
+	}
+}
+
+// Position of the first item of a level, which follows the higher levels
+static uint32_t esdm_sketch_start(const esdm_sketch_t * sketch, uint32_t h)
+{
+	uint32_t g, start = 0;
+	for (g = h + 1; g < sketch->levels; ++g)
+		start += sketch->count[g];
+	return start;
+}
+
+// Sort items in place, comparisons are inlined since compactions are the most expensive step of the updates
+static void esdm_sketch_sort(double *item, uint32_t n)
+{
+	uint32_t i, j;
+	double pivot, t;
+	while (n > 16) {
+		// Median of three is used as pivot
+		i = n / 2;
+		if (item[i] < item[0])
+			t = item[i], item[i] = item[0], item[0] = t;
+		if (item[n - 1] < item[i])
+			t = item[i], item[i] = item[n - 1], item[n - 1] = t;
+		if (item[i] < item[0])
+			t = item[i], item[i] = item[0], item[0] = t;
+		pivot = item[i];
+		for (i = 0, j = n - 1;; ++i, --j) {
+			while (item[i] < pivot)
+				++i;
+			while (pivot < item[j])
+				--j;
+			if (i >= j)
+				break;
+			t = item[i], item[i] = item[j], item[j] = t;
+		}
+		// Recursion on the smaller part bounds the depth of the stack
+		if (j + 1 < n - j - 1) {
+			esdm_sketch_sort(item, j + 1);
+			item += j + 1;
+			n -= j + 1;
+		} else {
+			esdm_sketch_sort(item + j + 1, n - j - 1);
+			n = j + 1;
+		}
+	}
+	for (i = 1; i < n; ++i) {
+		for (t = item[i], j = i; (j > 0) && (t < item[j - 1]); --j)
+			item[j] = item[j - 1];
+		item[j] = t;
+	}
+}
+
+static int esdm_compare_rank(const void *a, const void *b)
+{
+	double x = ((const esdm_sketch_rank_t *) a)->value, y = ((const esdm_sketch_rank_t *) b)->value;
+	return (x > y) - (x < y);
+}
+
+void esdm_sketch_init(esdm_sketch_t * sketch, uint32_t k)
+{
+	memset(sketch, 0, sizeof(esdm_sketch_t));
+	sketch->k = k;
+	sketch->capacity = esdm_sketch_max_items(k);
+	sketch->min = INFINITY;
+	sketch->max = -INFINITY;
+	esdm_sketch_grow(sketch);
+}
+
+// Sort a level and promote one item of each pair to the next level, keeping the smallest item in case the number is odd
+static int esdm_sketch_compact(esdm_sketch_t * sketch, uint32_t h)
+{
+	if (h + 1 >= sketch->levels)
+		esdm_sketch_grow(sketch);
+	if (h + 1 >= sketch->levels)
+		return 0;
+
+	uint32_t i, first = esdm_sketch_start(sketch, h), n = sketch->count[h], odd = n & 1, half = n / 2;
+	uint32_t parity = (sketch->parity >> h) & 1;
+	double *item = sketch->item + first, rest;
+
+	esdm_sketch_sort(item, n);
+	rest = item[0];
+	// Promoted items are moved at the end of the next level, which is stored right before this one
+	for (i = 0; i < half; ++i)
+		item[i] = item[odd + 2 * i + parity];
+	if (odd)
+		item[half] = rest;
+	memmove(item + half + odd, item + n, (sketch->size - first - n) * sizeof(double));
+
+	sketch->parity ^= 1ULL << h;
+	sketch->count[h + 1] += half;
+	sketch->count[h] = odd;
+	sketch->size -= half;
+
+	return 1;
+}
+
+void esdm_sketch_compress(esdm_sketch_t * sketch)
+{
+	uint32_t h;
+	int compacted = 1;
+	while (compacted && (sketch->size >= sketch->limit))
+		for (h = 0, compacted = 0; (h < sketch->levels) && (sketch->size >= sketch->limit); ++h)
+			if (sketch->count[h] >= sketch->width[h])
+				compacted |= esdm_sketch_compact(sketch, h);
+}
+
+esdm_status esdm_sketch_merge(esdm_sketch_t * sketch, const esdm_sketch_t * other)
+{
+	uint32_t h, at;
+	if ((sketch->k != other->k) || (sketch->size + other->size > sketch->capacity))
+		return ESDM_ERROR;
+
+	while (sketch->levels < other->levels)
+		esdm_sketch_grow(sketch);
+
+	// Items of each level are appended to the same level of the sketch
+	for (h = 0; h < other->levels; ++h) {
+		at = esdm_sketch_start(sketch, h) + sketch->count[h];
+		memmove(sketch->item + at + other->count[h], sketch->item + at, (sketch->size - at) * sizeof(double));
+		memcpy(sketch->item + at, other->item + esdm_sketch_start(other, h), other->count[h] * sizeof(double));
+		sketch->count[h] += other->count[h];
+		sketch->size += other->count[h];
+	}
+	sketch->n += other->n;
+	sketch->min = other->min < sketch->min ? other->min : sketch->min;
+	sketch->max = other->max > sketch->max ? other->max : sketch->max;
+
+	esdm_sketch_compress(sketch);
+
+	return ESDM_SUCCESS;
+}
+
+// The quantile of probability q is the smallest item whose rank is at least q * n
+esdm_status esdm_sketch_quantiles(const esdm_sketch_t * sketch, const double *q, int n, double *out)
+{
+	uint32_t h, i, j, first, last, middle;
+	esdm_sketch_rank_t *rank = (esdm_sketch_rank_t *) malloc(sketch->size * sizeof(esdm_sketch_rank_t) + 1);
+	if (!rank)
+		return ESDM_ERROR;
+
+	for (h = sketch->levels, i = 0; h-- > 0;)
+		for (j = 0; j < sketch->count[h]; ++j, ++i) {
+			rank[i].value = sketch->item[i];
+			rank[i].weight = 1ULL << h;
+		}
+	qsort(rank, sketch->size, sizeof(esdm_sketch_rank_t), esdm_compare_rank);
+	for (i = 1; i < sketch->size; ++i)
+		rank[i].weight += rank[i - 1].weight;
+
+	for (j = 0; j < (uint32_t) n; ++j) {
+		if (!sketch->size || (q[j] <= 0) || (q[j] >= 1)) {
+			out[j] = q[j] < 1 ? sketch->min : sketch->max;
+			continue;
+		}
+		double target = ceil(q[j] * sketch->n);
+		for (first = 0, last = sketch->size - 1; first < last;) {
+			middle = (first + last) / 2;
+			if ((double) rank[middle].weight < target)
+				first = middle + 1;
+			else
+				last = middle;
+		}
+		out[j] = rank[first].value;
+	}
+
+	free(rank);
+
+	return ESDM_SUCCESS;
+}
+
+// Estimate of the number of distinct values, corrected by linear counting for small cardinalities
+double esdm_distinct_estimate(const uint8_t * reg, int precision)
+{
+	uint64_t i, m = 1ULL << precision, zeros = 0;
+	double sum = 0, alpha, estimate;
+	for (i = 0; i < m; ++i) {
+		sum += ldexp(1.0, -reg[i]);
+		zeros += !reg[i];
+	}
+	alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m);
+	estimate = alpha * m * m / sum;
+	if ((estimate <= 2.5 * m) && zeros)
+		return m * log((double) m / zeros);
+	return estimate;
+}
@@ -0,0 +1,1000 @@
+/*
+    ESDM-PAV Analytical Kernels
+    Copyright (C) 2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Results of the operations compared with naive references, for the scalar kernels and each variant of the vectorized kernels
+// built and supported by the CPU, with and without splitting fragments among OpenMP threads: the test data are read by several
+// fragments in order, in reverse order and concurrently (after esdm_stream_prepare_concurrent), with no fill value, a fill value
+// and a NaN fill value; the exit status is not zero in case some result differs from the reference
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esdm_kernels_internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ESDM_CPU_SUPPORTS(feature) __builtin_cpu_supports(feature)
+#else
+#define ESDM_CPU_SUPPORTS(feature) 0
+#endif
+
+// Shape and offset of the dataspace being read, by fragments of ESDM_TEST_ROWS rows (the last one is shorter), which are larger
+// than ESDM_TEST_PARALLEL_BYTES, so that they are split among threads when parallel processing is enabled
+#define ESDM_TEST_T 240
+#define ESDM_TEST_X 50
+#define ESDM_TEST_N (ESDM_TEST_T * ESDM_TEST_X)
+#define ESDM_TEST_OFFSET_T 100
+#define ESDM_TEST_OFFSET_X 10
+#define ESDM_TEST_ROWS 17
+#define ESDM_TEST_PARALLEL_BYTES 1024
+
+// Every ESDM_TEST_GAP-th element is missing in case of a fill value
+#define ESDM_TEST_GAP 13
+#define ESDM_TEST_FILL -999
+
+// Range of the values of 16-bit integers, large enough for the sums of the vectorized kernels to be rounded differently than the exact ones
+#define ESDM_TEST_RANGE 100
+
+typedef enum {
+	ESDM_TEST_SERIAL,
+	ESDM_TEST_REVERSED,
+	ESDM_TEST_CONCURRENT,
+	ESDM_TEST_ORDER_N
+} esdm_test_order_t;
+
+typedef enum {
+	ESDM_TEST_FILL_NONE,
+	ESDM_TEST_FILL_VALUE,
+	ESDM_TEST_FILL_NAN,
+	ESDM_TEST_FILL_N
+} esdm_test_fill_t;
+
+static const char *esdm_test_orders[ESDM_TEST_ORDER_N] = { "serial", "reversed", "concurrent" };
+static const char *esdm_test_fills[ESDM_TEST_FILL_N] = { "no fill value", "fill value", "NaN fill value" };
+
+// Variant being tested, reported with the failures
+static const char *esdm_test_isa;
+
+// Test data for each fill mode: double-precision values in [250, 350) with ties of the maximum and of the minimum,
+// and 16-bit integers in [-ESDM_TEST_RANGE, ESDM_TEST_RANGE]
+static double esdm_test_double[ESDM_TEST_FILL_N][ESDM_TEST_N];
+static int16_t esdm_test_int16[ESDM_TEST_FILL_N][ESDM_TEST_N];
+static double esdm_test_double_fill[ESDM_TEST_FILL_N];
+static int16_t esdm_test_int16_fill = 7;
+
+// Valid elements reduced by the references
+typedef struct _esdm_test_acc_t {
+	double n;
+	double sum;
+	double sum2;
+	double min;
+	double max;
+} esdm_test_acc_t;
+
+typedef struct _esdm_test_deliver_t {
+	void *out;
+	esdm_dataspace_t *space;
+} esdm_test_deliver_t;
+
+// Linear congruential generator, so that the data do not depend on the C library
+static uint64_t esdm_test_random(void)
+{
+	static uint64_t state = 42;
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return state >> 33;
+}
+
+static const void *esdm_test_fill_value(int fill, esdm_type_t type)
+{
+	if (fill == ESDM_TEST_FILL_NONE)
+		return NULL;
+	return type == SMD_DTYPE_INT16 ? (const void *) &esdm_test_int16_fill : (const void *) &esdm_test_double_fill[fill];
+}
+
+static int esdm_test_valid(double x, const double *fill)
+{
+	return !fill || (isnan(*fill) ? x == x : x != *fill);
+}
+
+static double esdm_test_value(esdm_type_t type, const void *buff, size_t i)
+{
+	if (type == SMD_DTYPE_INT8)
+		return ((const int8_t *) buff)[i];
+	if (type == SMD_DTYPE_INT16)
+		return ((const int16_t *) buff)[i];
+	if (type == SMD_DTYPE_INT32)
+		return ((const int32_t *) buff)[i];
+	if (type == SMD_DTYPE_INT64)
+		return (double) ((const int64_t *) buff)[i];
+	if (type == SMD_DTYPE_UINT8)
+		return ((const uint8_t *) buff)[i];
+	if (type == SMD_DTYPE_UINT16)
+		return ((const uint16_t *) buff)[i];
+	if (type == SMD_DTYPE_UINT32)
+		return ((const uint32_t *) buff)[i];
+	if (type == SMD_DTYPE_UINT64)
+		return (double) ((const uint64_t *) buff)[i];
+	if (type == SMD_DTYPE_FLOAT)
+		return ((const float *) buff)[i];
+	return ((const double *) buff)[i];
+}
+
+// Value i of the output of the operation given in request, whose values are of the dataset type but the number of distinct values
+// and the counters of stat, which follow the other statistics as int64_t from the first offset aligned to 8 bytes
+static double esdm_test_output(const esdm_stream_data_t * request, esdm_type_t type, size_t size, const void *out, size_t i)
+{
+	size_t values = 0, k;
+	if (!strcmp(request->operation, ESDM_FUNCTION_COUNT_DISTINCT))
+		return (double) ((const int64_t *) out)[i];
+	if (strcmp(request->operation, ESDM_FUNCTION_STAT))
+		return esdm_test_value(type, out, i);
+	for (k = 0; (k < ESDM_STAT_COUNT) && request->args[k] && (request->args[k] != ESDM_SEPARATOR[0]); ++k)
+		values += request->args[k] == ESDM_FUNCTION_OP_SET;
+	if (i < values)
+		return esdm_test_value(type, out, i);
+	return (double) ((const int64_t *) out)[(values * size + sizeof(int64_t) - 1) / sizeof(int64_t) + i - values];
+}
+
+static int esdm_test_close(double result, double reference, double tol)
+{
+	if (isnan(result) || isnan(reference))
+		return isnan(result) && isnan(reference);
+	return fabs(result - reference) <= tol * (fabs(reference) > 1 ? fabs(reference) : 1);
+}
+
+static void esdm_test_add(esdm_test_acc_t * acc, double x)
+{
+	if (!acc->n || (x < acc->min))
+		acc->min = x;
+	if (!acc->n || (x > acc->max))
+		acc->max = x;
+	acc->n++;
+	acc->sum += x;
+	acc->sum2 += x * x;
+}
+
+// Result of a reduction among max, min, avg, sum, std, var (sample statistics), 0 in case of no valid element
+static double esdm_test_result(const char *operation, const esdm_test_acc_t * acc)
+{
+	double avg = acc->n ? acc->sum / acc->n : 0, var = acc->n > 1 ? (acc->sum2 - acc->n * avg * avg) / (acc->n - 1) : 0;
+	if (!acc->n)
+		return 0;
+	if (!strcmp(operation, ESDM_FUNCTION_MAX))
+		return acc->max;
+	if (!strcmp(operation, ESDM_FUNCTION_MIN))
+		return acc->min;
+	if (!strcmp(operation, ESDM_FUNCTION_AVG))
+		return avg;
+	if (!strcmp(operation, ESDM_FUNCTION_SUM))
+		return acc->sum;
+	if (!strcmp(operation, ESDM_FUNCTION_STD))
+		return sqrt(var);
+	return var;
+}
+
+// Copy a fragment transformed in place into the output buffer, at the position of the fragment in the dataspace being read
+static void esdm_test_deliver(esdm_dataspace_t * space, void *buff, void *deliver_ptr)
+{
+	esdm_test_deliver_t *deliver = (esdm_test_deliver_t *) deliver_ptr;
+	int64_t bytes = esdm_dataspace_total_bytes(space), rows = esdm_dataspace_get_size(space)[0];
+	int64_t row = esdm_dataspace_get_offset(space)[0] - esdm_dataspace_get_offset(deliver->space)[0];
+	memcpy((char *) deliver->out + row * (bytes / rows), buff, bytes);
+}
+
+// Read the dataspace by fragments of the given number of rows (along the first dimension), as long as esdm_stream_next_pass asks for
+static int esdm_test_read(esdm_stream_data_t * stream_data, esdm_dataspace_t * space, void *data, int64_t rows, int order)
+{
+	int64_t dims = esdm_dataspace_get_dims(space), fragments, f;
+	const int64_t *size = esdm_dataspace_get_size(space), *offset = esdm_dataspace_get_offset(space);
+	size_t bytes = esdm_dataspace_total_bytes(space) / size[0];	// Size of a row
+	int pass, failed = 0;
+
+	if ((order == ESDM_TEST_CONCURRENT) && esdm_stream_prepare_concurrent(stream_data))
+		return 1;
+
+	fragments = (size[0] + rows - 1) / rows;
+	do {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (order == ESDM_TEST_CONCURRENT)
+#endif
+		for (f = 0; f < fragments; ++f) {
+			int64_t k = order == ESDM_TEST_REVERSED ? fragments - 1 - f : f, fsize[dims], foffset[dims];
+			esdm_dataspace_t *fragment;
+			memcpy(fsize, size, dims * sizeof(int64_t));
+			memcpy(foffset, offset, dims * sizeof(int64_t));
+			foffset[0] += k * rows;
+			fsize[0] = size[0] - k * rows < rows ? size[0] - k * rows : rows;
+			if (esdm_dataspace_subspace(space, dims, fsize, foffset, &fragment)) {
+				__atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			void *out = esdm_stream_func(fragment, (char *) data + k * rows * bytes, stream_data, NULL);
+			if (out)
+				esdm_reduce_func(fragment, stream_data, out);
+			esdm_dataspace_destroy(fragment);
+		}
+		if (esdm_reduce_finalize(space, stream_data))
+			return 1;
+	} while ((pass = esdm_stream_next_pass(space, stream_data)) > 0);
+
+	return failed || (pass < 0);
+}
+
+// Read the data in each order by the operation given in request and compare the n values of the output with the reference
+static int esdm_test_check(const char *name, const esdm_stream_data_t * request, esdm_dataspace_t * space, const void *data, int64_t rows,
+			   const double *reference, size_t n, double tol)
+{
+	esdm_type_t type = esdm_dataspace_get_type(space);
+	size_t i, bytes = esdm_dataspace_total_bytes(space), size = bytes / esdm_dataspace_element_count(space);
+	int order, failed = 0;
+	void *in = malloc(bytes), *out = malloc(bytes + n * sizeof(double));
+	if (!in || !out) {
+		free(in);
+		free(out);
+		return 1;
+	}
+
+	for (order = 0; order < ESDM_TEST_ORDER_N; ++order) {
+		esdm_stream_data_t stream_data;
+		esdm_test_deliver_t deliver = { out, space };
+		memcpy(&stream_data, request, sizeof(esdm_stream_data_t));
+		stream_data.buff = out;
+		stream_data.space = space;
+		stream_data.context = NULL;
+		if (request->in_place) {
+			stream_data.deliver = esdm_test_deliver;
+			stream_data.deliver_ptr = &deliver;
+		}
+		memcpy(in, data, bytes);	// Overwritten by operations in place
+		memset(out, 0, bytes + n * sizeof(double));
+
+		int error = esdm_test_read(&stream_data, space, in, rows, order);
+		esdm_stream_release(&stream_data);
+		if (error) {
+			printf("%s: %s(%s) of %s failed in %s order\n", esdm_test_isa, request->operation, request->args ? request->args : "", name,
+			       esdm_test_orders[order]);
+			failed++;
+			continue;
+		}
+		for (i = 0; i < n; ++i)
+			if (!esdm_test_close(esdm_test_output(request, type, size, out, i), reference[i], tol)) {
+				printf("%s: %s(%s) of %s in %s order: value %zu is %.17g instead of %.17g\n", esdm_test_isa, request->operation,
+				       request->args ? request->args : "", name, esdm_test_orders[order], i, esdm_test_output(request, type, size, out, i),
+				       reference[i]);
+				failed++;
+				break;
+			}
+	}
+
+	free(in);
+	free(out);
+	return failed;
+}
+
+static int esdm_test_run(const char *name, const char *operation, const char *args, const void *fill_value, esdm_dataspace_t * space,
+			 const void *data, const double *reference, size_t n, double tol)
+{
+	esdm_stream_data_t request;
+	memset(&request, 0, sizeof(esdm_stream_data_t));
+	request.operation = (char *) operation;
+	request.args = (char *) args;
+	request.fill_value = (void *) fill_value;
+	return esdm_test_check(name, &request, space, data, ESDM_TEST_ROWS, reference, n, tol);
+}
+
+// Statistics over all the elements, also in a single pass by stat
+static int esdm_test_stat(esdm_dataspace_t * space)
+{
+	static const char *operations[] = { ESDM_FUNCTION_MIN, ESDM_FUNCTION_MAX, ESDM_FUNCTION_AVG, ESDM_FUNCTION_STD, ESDM_FUNCTION_VAR, ESDM_FUNCTION_SUM };
+	int fill, i, failed = 0;
+	size_t j;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		double values[ESDM_STAT_N];
+		esdm_test_acc_t acc;
+		memset(&acc, 0, sizeof(esdm_test_acc_t));
+		values[ESDM_STAT_MISSING] = values[ESDM_STAT_OUTLIER] = 0;
+		for (j = 0; j < ESDM_TEST_N; ++j)
+			if (esdm_test_valid(data[j], fill_value)) {
+				esdm_test_add(&acc, data[j]);
+				values[ESDM_STAT_OUTLIER] += data[j] > 300;
+			} else
+				values[ESDM_STAT_MISSING]++;
+		for (i = 0; i <= ESDM_STAT_SUM; ++i) {
+			values[i] = esdm_test_result(operations[i], &acc);
+			failed += esdm_test_run(esdm_test_fills[fill], operations[i], NULL, fill_value, space, data, values + i, 1, 1e-9);
+		}
+		values[ESDM_STAT_COUNT] = acc.n;
+		failed += esdm_test_run(esdm_test_fills[fill], ESDM_FUNCTION_STAT, "111111111,>300", fill_value, space, data, values, ESDM_STAT_N, 1e-9);
+		failed += esdm_test_run(esdm_test_fills[fill], ESDM_FUNCTION_OUTLIER, ">300", fill_value, space, data, values + ESDM_STAT_OUTLIER, 1, 0);
+	}
+
+	return failed;
+}
+
+// Sums and extremes of integers are exact, for the vectorized kernels as well
+static int esdm_test_integer(esdm_dataspace_t * space)
+{
+	int fill, failed = 0;
+	size_t j;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_NAN; ++fill) {
+		const int16_t *data = esdm_test_int16[fill];
+		const double fv = esdm_test_int16_fill;
+		const void *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_INT16);
+		double values[ESDM_STAT_N], stat[ESDM_STAT_N], distinct = 0;
+		char seen[2 * ESDM_TEST_RANGE + 1];
+		esdm_test_acc_t acc;
+		memset(&acc, 0, sizeof(esdm_test_acc_t));
+		memset(seen, 0, sizeof(seen));
+		values[ESDM_STAT_MISSING] = values[ESDM_STAT_OUTLIER] = 0;
+		for (j = 0; j < ESDM_TEST_N; ++j)
+			if (esdm_test_valid(data[j], fill_value ? &fv : NULL)) {
+				esdm_test_add(&acc, data[j]);
+				values[ESDM_STAT_OUTLIER] += data[j] > 10;
+				distinct += !seen[data[j] + ESDM_TEST_RANGE];
+				seen[data[j] + ESDM_TEST_RANGE] = 1;
+			} else
+				values[ESDM_STAT_MISSING]++;
+		values[ESDM_STAT_MIN] = acc.min;
+		values[ESDM_STAT_MAX] = acc.max;
+		values[ESDM_STAT_SUM] = acc.sum;
+		values[ESDM_STAT_COUNT] = acc.n;
+
+		const char *name = fill ? "int16 with fill value" : "int16";
+		failed += esdm_test_run(name, ESDM_FUNCTION_SUM, NULL, fill_value, space, data, values + ESDM_STAT_SUM, 1, 0);
+		failed += esdm_test_run(name, ESDM_FUNCTION_MAX, NULL, fill_value, space, data, values + ESDM_STAT_MAX, 1, 0);
+		failed += esdm_test_run(name, ESDM_FUNCTION_MIN, NULL, fill_value, space, data, values + ESDM_STAT_MIN, 1, 0);
+		failed += esdm_test_run(name, ESDM_FUNCTION_COUNT_DISTINCT, NULL, fill_value, space, data, &distinct, 1, 0);
+
+		// Minimum, maximum, sum and counters
+		stat[0] = values[ESDM_STAT_MIN];
+		stat[1] = values[ESDM_STAT_MAX];
+		memcpy(stat + 2, values + ESDM_STAT_SUM, 4 * sizeof(double));
+		failed += esdm_test_run(name, ESDM_FUNCTION_STAT, "110001111,>10", fill_value, space, data, stat, 6, 0);
+	}
+
+	// Counters beyond the largest value of an 8-bit type
+	static uint8_t bytes[1000];
+	const uint8_t zero = 0;
+	int64_t size = sizeof(bytes), offset = 0;
+	double counters[2] = { 0, 0 };
+	esdm_dataspace_t *vector;
+	if (esdm_dataspace_create_full(1, &size, &offset, SMD_DTYPE_UINT8, &vector))
+		return failed + 1;
+	for (j = 0; j < sizeof(bytes); ++j) {
+		bytes[j] = j % 3;
+		counters[!bytes[j]]++;
+	}
+	esdm_stream_data_t request;
+	memset(&request, 0, sizeof(esdm_stream_data_t));
+	request.operation = ESDM_FUNCTION_STAT;
+	request.args = "00000011";
+	request.fill_value = (void *) &zero;
+	failed += esdm_test_check("uint8", &request, vector, bytes, 100, counters, 2, 0);
+	esdm_dataspace_destroy(vector);
+
+	// All the 256 values of an 8-bit type
+	static int8_t classes[1024];
+	double distinct = 256;
+	size = sizeof(classes);
+	if (esdm_dataspace_create_full(1, &size, &offset, SMD_DTYPE_INT8, &vector))
+		return failed + 1;
+	for (j = 0; j < sizeof(classes); ++j)
+		classes[j] = (int8_t) (j * 37);
+	request.operation = ESDM_FUNCTION_COUNT_DISTINCT;
+	request.args = NULL;
+	request.fill_value = NULL;
+	failed += esdm_test_check("int8", &request, vector, classes, 100, &distinct, 1, 0);
+	esdm_dataspace_destroy(vector);
+
+	return failed;
+}
+
+// Reference of an axis-wise reduction of the test data: dimensions whose bit is set in mask are collapsed, unless the first one is grouped by period
+static size_t esdm_test_axis_reference(const char *operation, const double *data, const double *fill, int mask, int period, int phase, double *reference)
+{
+	size_t t, x, rows = period ? (size_t) period : mask & 1 ? 1 : ESDM_TEST_T, columns = mask & 2 ? 1 : ESDM_TEST_X, i;
+	esdm_test_acc_t *acc = calloc(rows * columns, sizeof(esdm_test_acc_t));
+	if (!acc)
+		return 0;
+
+	for (t = 0; t < ESDM_TEST_T; ++t)
+		for (x = 0; x < ESDM_TEST_X; ++x)
+			if (esdm_test_valid(data[t * ESDM_TEST_X + x], fill)) {
+				size_t row = period ? (ESDM_TEST_OFFSET_T + t + phase) % period : mask & 1 ? 0 : t, column = mask & 2 ? 0 : x;
+				esdm_test_add(acc + row * columns + column, data[t * ESDM_TEST_X + x]);
+			}
+	for (i = 0; i < rows * columns; ++i)
+		reference[i] = esdm_test_result(operation, acc + i);
+
+	free(acc);
+	return rows * columns;
+}
+
+// Reductions along dimensions and by cyclic index
+static int esdm_test_axis(esdm_dataspace_t * space)
+{
+	static const struct {
+		const char *operation;
+		const char *args;
+		int mask;
+		int period;
+		int phase;
+	} axes[] = {
+		{ESDM_FUNCTION_AVG, "0", 1, 0, 0},
+		{ESDM_FUNCTION_MAX, "1", 2, 0, 0},
+		{ESDM_FUNCTION_STD, "0", 1, 0, 0},
+		{ESDM_FUNCTION_SUM, "0,1", 3, 0, 0},
+		{ESDM_FUNCTION_AVG, "0%12", 1, 12, 0},
+		{ESDM_FUNCTION_MIN, "0%12+3", 1, 12, 3},
+		{ESDM_FUNCTION_VAR, "0%7,1", 3, 7, 0},
+		{ESDM_FUNCTION_SUM, "0%365", 1, 365, 0},
+	};
+	static double reference[365 * ESDM_TEST_X];	// A slab for each group
+	int fill, failed = 0;
+	size_t i, n;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		for (i = 0; i < sizeof(axes) / sizeof(axes[0]); ++i) {
+			if (!(n = esdm_test_axis_reference(axes[i].operation, data, fill_value, axes[i].mask, axes[i].period, axes[i].phase, reference)))
+				return failed + 1;
+			failed += esdm_test_run(esdm_test_fills[fill], axes[i].operation, axes[i].args, fill_value, space, data, reference, n, 1e-9);
+		}
+	}
+
+	// Groups beyond the length of a dataspace shorter than the period: 10 steps from 5 fill the groups from 5 to 11 and from 0 to 2
+	int64_t size = 10, offset = 5;
+	esdm_dataspace_t *vector;
+	if (esdm_dataspace_create_full(1, &size, &offset, SMD_DTYPE_DOUBLE, &vector))
+		return failed + 1;
+	memset(reference, 0, 12 * sizeof(double));
+	for (i = 0; i < (size_t) size; ++i)
+		reference[(offset + i) % 12] = esdm_test_double[ESDM_TEST_FILL_NONE][i];
+	esdm_stream_data_t request;
+	memset(&request, 0, sizeof(esdm_stream_data_t));
+	request.operation = ESDM_FUNCTION_AVG;
+	request.args = "0%12";
+	failed += esdm_test_check("short dataspace", &request, vector, esdm_test_double[ESDM_TEST_FILL_NONE], 3, reference, 12, 0);
+	esdm_dataspace_destroy(vector);
+
+	// Fragments shorter than the period, whose cells are mapped to the groups by their offset
+	request.operation = ESDM_FUNCTION_VAR;
+	request.args = "0%365";
+	request.fill_value = &esdm_test_double_fill[ESDM_TEST_FILL_VALUE];
+	if (!(n = esdm_test_axis_reference(request.operation, esdm_test_double[ESDM_TEST_FILL_VALUE], request.fill_value, 1, 365, 0, reference)))
+		return failed + 1;
+	failed += esdm_test_check("single steps", &request, space, esdm_test_double[ESDM_TEST_FILL_VALUE], 1, reference, n, 1e-9);
+	request.args = "0%12+3";
+	if (!(n = esdm_test_axis_reference(request.operation, esdm_test_double[ESDM_TEST_FILL_VALUE], request.fill_value, 1, 12, 3, reference)))
+		return failed + 1;
+	failed += esdm_test_check("single steps", &request, space, esdm_test_double[ESDM_TEST_FILL_VALUE], 1, reference, n, 1e-9);
+	failed += esdm_test_check("fragments of 5 steps", &request, space, esdm_test_double[ESDM_TEST_FILL_VALUE], 5, reference, n, 1e-9);
+
+	// NaN elements are skipped by max and min also in case of no fill value
+	for (i = 0; i < 2; ++i) {
+		const double *data = esdm_test_double[ESDM_TEST_FILL_NAN];
+		const char *operation = i ? ESDM_FUNCTION_MIN : ESDM_FUNCTION_MAX, *args = i ? "1" : "0%12";
+		if (!(n = esdm_test_axis_reference(operation, data, &esdm_test_double_fill[ESDM_TEST_FILL_NAN], i ? 2 : 1, i ? 0 : 12, 0, reference)))
+			return failed + 1;
+		failed += esdm_test_run("NaN and no fill value", operation, args, NULL, space, data, reference, n, 0);
+	}
+
+	return failed;
+}
+
+// Histograms of bins of the same width and of given edges, followed by the numbers of elements below and above the range and of missing elements
+static int esdm_test_histogram(esdm_dataspace_t * space)
+{
+	static const double uniform[] = { 250, 262.5, 275, 287.5, 300, 312.5, 325, 337.5, 350 }, edges[] = { 250, 260, 300, 400 };
+	int fill, failed = 0, bins, k;
+	size_t j;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		for (k = 0; k < 2; ++k) {
+			const double *e = k ? edges : uniform;
+			double reference[sizeof(uniform) / sizeof(double) + 2];
+			bins = k ? sizeof(edges) / sizeof(double) - 1 : sizeof(uniform) / sizeof(double) - 1;
+			memset(reference, 0, sizeof(reference));
+			for (j = 0; j < ESDM_TEST_N; ++j) {
+				double x = data[j];
+				int b;
+				if (!esdm_test_valid(x, fill_value))
+					reference[bins + 2]++;
+				else if (x < e[0])
+					reference[bins]++;
+				else if (!(x < e[bins]))
+					reference[bins + 1]++;
+				else {
+					for (b = 0; x >= e[b + 1]; ++b);
+					reference[b]++;
+				}
+			}
+			failed += esdm_test_run(esdm_test_fills[fill], ESDM_FUNCTION_HISTOGRAM, k ? ":250,260,300,400" : "8,250,350", fill_value, space, data, reference,
+						bins + 3, 0);
+		}
+	}
+
+	return failed;
+}
+
+static int esdm_test_compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+// Exact percentiles and quantiles estimated by the sketch, whose rank has to be within the error bound
+static int esdm_test_quantile(esdm_dataspace_t * space)
+{
+	static const double percentages[] = { 5, 50, 95 }, probabilities[] = { 0.1, 0.5, 0.9 };
+	static double sorted[ESDM_TEST_N];
+	int fill, order, failed = 0;
+	size_t i, j, n;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		double reference[3], out[3];
+		for (j = n = 0; j < ESDM_TEST_N; ++j)
+			if (esdm_test_valid(data[j], fill_value))
+				sorted[n++] = data[j];
+		qsort(sorted, n, sizeof(double), esdm_test_compare_double);
+		for (i = 0; i < 3; ++i) {
+			size_t rank = (size_t) ceil(percentages[i] / 100 * n);
+			reference[i] = sorted[rank ? rank - 1 : 0];
+		}
+		failed += esdm_test_run(esdm_test_fills[fill], ESDM_FUNCTION_PERCENTILE, "5,50,95", fill_value, space, data, reference, 3, 0);
+
+		for (order = 0; order < ESDM_TEST_ORDER_N; ++order) {
+			esdm_stream_data_t stream_data;
+			memset(&stream_data, 0, sizeof(esdm_stream_data_t));
+			stream_data.operation = ESDM_FUNCTION_QUANTILE;
+			stream_data.args = "0.1,0.5,0.9";
+			stream_data.fill_value = (void *) fill_value;
+			stream_data.buff = out;
+			stream_data.space = space;
+			int error = esdm_test_read(&stream_data, space, (void *) data, ESDM_TEST_ROWS, order);
+			esdm_stream_release(&stream_data);
+			for (i = 0; i < 3; ++i) {
+				// Range of the ranks of the result among the valid elements
+				double below = 0, above = 0;
+				for (j = 0; j < n; ++j) {
+					below += sorted[j] < out[i];
+					above += sorted[j] <= out[i];
+				}
+				if (error || (below / n > probabilities[i] + 0.02) || (above / n < probabilities[i] - 0.02)) {
+					printf("%s: %s of %s in %s order: quantile %g is %.17g, of rank between %g and %g\n", esdm_test_isa, ESDM_FUNCTION_QUANTILE,
+					       esdm_test_fills[fill], esdm_test_orders[order], probabilities[i], out[i], below / n, above / n);
+					failed++;
+					break;
+				}
+			}
+		}
+	}
+
+	return failed;
+}
+
+// Read the data in each order by argmax or argmin, whose output is compared with the element at index, in row-major order,
+// and its global coordinates (up to two dimensions)
+static int esdm_test_arg_check(const char *name, const char *operation, esdm_dataspace_t * space, const double *data, const void *fill_value, int64_t rows,
+			       size_t index)
+{
+	int64_t dims = esdm_dataspace_get_dims(space), reference[2] = { 0, 0 }, i, j;
+	const int64_t *size = esdm_dataspace_get_size(space), *offset = esdm_dataspace_get_offset(space);
+	int order, failed = 0;
+
+	for (i = dims - 1, j = index; i >= 0; --i) {
+		reference[i] = offset[i] + j % size[i];
+		j /= size[i];
+	}
+	for (order = 0; order < ESDM_TEST_ORDER_N; ++order) {
+		char out[ESDM_ARG_COORDINATES_OFFSET + 2 * sizeof(int64_t)];
+		int64_t coordinates[2];
+		double value;
+		esdm_stream_data_t stream_data;
+		memset(out, 0, sizeof(out));
+		memset(&stream_data, 0, sizeof(esdm_stream_data_t));
+		stream_data.operation = (char *) operation;
+		stream_data.fill_value = (void *) fill_value;
+		stream_data.buff = out;
+		stream_data.space = space;
+		int error = esdm_test_read(&stream_data, space, (void *) data, rows, order);
+		esdm_stream_release(&stream_data);
+		memcpy(&value, out, sizeof(double));
+		memcpy(coordinates, out + ESDM_ARG_COORDINATES_OFFSET, sizeof(coordinates));
+		if (error || (value != data[index]) || (coordinates[0] != reference[0]) || ((dims > 1) && (coordinates[1] != reference[1]))) {
+			printf("%s: %s of %s in %s order is %.17g at (%" PRId64 ", %" PRId64 ") instead of %.17g at (%" PRId64 ", %" PRId64 ")\n", esdm_test_isa,
+			       operation, name, esdm_test_orders[order], value, coordinates[0], coordinates[1], data[index], reference[0], reference[1]);
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+// Extremes and their global coordinates, where ties are resolved by the first element in row-major order and NaN elements are skipped
+static int esdm_test_arg(esdm_dataspace_t * space)
+{
+	static const double nans[] = { NAN, 3, 7, 1, 2 };
+	int64_t size = sizeof(nans) / sizeof(double), offset = 0;
+	esdm_dataspace_t *vector;
+	int fill, k, failed = 0;
+	size_t j;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		for (k = 0; k < 2; ++k) {
+			size_t index = 0;
+			for (j = 0; j < ESDM_TEST_N; ++j)
+				if (esdm_test_valid(data[j], fill_value) && (!esdm_test_valid(data[index], fill_value) || (k ? data[j] < data[index] : data[j] > data[index])))
+					index = j;
+			failed += esdm_test_arg_check(esdm_test_fills[fill], k ? ESDM_FUNCTION_ARGMIN : ESDM_FUNCTION_ARGMAX, space, data, fill_value, ESDM_TEST_ROWS, index);
+		}
+	}
+
+	// A leading NaN is not taken as the extreme in case of no fill value
+	if (esdm_dataspace_create_full(1, &size, &offset, SMD_DTYPE_DOUBLE, &vector))
+		return failed + 1;
+	failed += esdm_test_arg_check("NaN and no fill value", ESDM_FUNCTION_ARGMAX, vector, nans, NULL, 2, 2);
+	failed += esdm_test_arg_check("NaN and no fill value", ESDM_FUNCTION_ARGMIN, vector, nans, NULL, 2, 3);
+	esdm_dataspace_destroy(vector);
+
+	return failed;
+}
+
+// Distinct values of double-precision elements are estimated by the sketch, within a few times its relative error
+static int esdm_test_distinct(esdm_dataspace_t * space)
+{
+	static double sorted[ESDM_TEST_N];
+	int fill, failed = 0;
+	size_t j, n;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		double reference = 0;
+		for (j = n = 0; j < ESDM_TEST_N; ++j)
+			if (esdm_test_valid(data[j], fill_value))
+				sorted[n++] = data[j];
+		qsort(sorted, n, sizeof(double), esdm_test_compare_double);
+		for (j = 0; j < n; ++j)
+			reference += !j || (sorted[j] != sorted[j - 1]);
+		failed += esdm_test_run(esdm_test_fills[fill], ESDM_FUNCTION_COUNT_DISTINCT, "14", fill_value, space, data, &reference, 1, 0.04);
+	}
+
+	return failed;
+}
+
+// Weights given by a vector for each dimension and by an array of all the elements
+static int esdm_test_weighted(esdm_dataspace_t * space)
+{
+	static const char *operations[] = { ESDM_FUNCTION_WSUM, ESDM_FUNCTION_WAVG, ESDM_FUNCTION_WSTD, ESDM_FUNCTION_WVAR };
+	static double array[ESDM_TEST_N];
+	double wt[ESDM_TEST_T], wx[ESDM_TEST_X];
+	const double *weights[2] = { wt, wx };
+	int fill, i, failed = 0;
+	size_t t, x;
+
+	for (t = 0; t < ESDM_TEST_T; ++t)
+		wt[t] = 1 + t % 3;
+	for (x = 0; x < ESDM_TEST_X; ++x)
+		wx[x] = 0.5 + (double) x / ESDM_TEST_X;
+	for (t = 0; t < ESDM_TEST_T; ++t)
+		for (x = 0; x < ESDM_TEST_X; ++x)
+			array[t * ESDM_TEST_X + x] = wt[t] * wx[x];
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		double w = 0, wsum = 0, wsum2 = 0, reference[4];
+		for (t = 0; t < ESDM_TEST_N; ++t)
+			if (esdm_test_valid(data[t], fill_value)) {
+				w += array[t];
+				wsum += array[t] * data[t];
+				wsum2 += array[t] * data[t] * data[t];
+			}
+		reference[0] = wsum;
+		reference[1] = wsum / w;
+		reference[3] = wsum2 / w - reference[1] * reference[1];
+		reference[2] = sqrt(reference[3]);
+
+		for (i = 0; i < 4; ++i) {
+			esdm_stream_data_t request;
+			memset(&request, 0, sizeof(esdm_stream_data_t));
+			request.operation = (char *) operations[i];
+			request.fill_value = (void *) fill_value;
+			request.weights = weights;
+			failed += esdm_test_check(esdm_test_fills[fill], &request, space, data, ESDM_TEST_ROWS, reference + i, 1, 1e-9);
+			request.weights = NULL;
+			request.weight_array = array;
+			failed += esdm_test_check(esdm_test_fills[fill], &request, space, data, ESDM_TEST_ROWS, reference + i, 1, 1e-9);
+		}
+	}
+
+	return failed;
+}
+
+// Reference of a rolling reduction of data of the given rows and columns, along the rows (dim 0) or the columns (dim 1)
+static void esdm_test_rolling_reference(const char *reduction, const double *data, const double *fill, int length, int dim, size_t rows, size_t columns,
+					double *reference)
+{
+	size_t t, x, j;
+
+	for (t = 0; t < rows; ++t)
+		for (x = 0; x < columns; ++x) {
+			size_t position = dim ? x : t, step = dim ? 1 : columns;
+			esdm_test_acc_t acc;
+			memset(&acc, 0, sizeof(esdm_test_acc_t));
+			for (j = position + 1 > (size_t) length ? position + 1 - length : 0; j <= position; ++j) {
+				double v = data[t * columns + x - (position - j) * step];
+				if (esdm_test_valid(v, fill))
+					esdm_test_add(&acc, v);
+			}
+			reference[t * columns + x] = esdm_test_result(reduction, &acc);
+		}
+}
+
+// Windows sliding along the first dimension, across fragments, and along the second one
+static int esdm_test_rolling(esdm_dataspace_t * space)
+{
+	static const struct {
+		const char *operation;
+		const char *reduction;
+		const char *args;
+		int length;
+		int dim;
+	} windows[] = {
+		{ESDM_FUNCTION_ROLLING_SUM, ESDM_FUNCTION_SUM, "5", 5, 0},
+		{ESDM_FUNCTION_ROLLING_AVG, ESDM_FUNCTION_AVG, "30", 30, 0},
+		{ESDM_FUNCTION_ROLLING_MAX, ESDM_FUNCTION_MAX, "7,0", 7, 0},
+		{ESDM_FUNCTION_ROLLING_MIN, ESDM_FUNCTION_MIN, "7", 7, 0},
+		{ESDM_FUNCTION_ROLLING_MAX, ESDM_FUNCTION_MAX, "4,1", 4, 1},
+	};
+	static double reference[ESDM_TEST_N], series[50];
+	int64_t size = sizeof(series) / sizeof(double), offset = 0;
+	esdm_dataspace_t *vector;
+	int fill, failed = 0;
+	size_t i;
+
+	for (fill = 0; fill < ESDM_TEST_FILL_N; ++fill) {
+		const double *data = esdm_test_double[fill], *fill_value = esdm_test_fill_value(fill, SMD_DTYPE_DOUBLE);
+		for (i = 0; i < sizeof(windows) / sizeof(windows[0]); ++i) {
+			esdm_test_rolling_reference(windows[i].reduction, data, fill_value, windows[i].length, windows[i].dim, ESDM_TEST_T, ESDM_TEST_X, reference);
+			failed += esdm_test_run(esdm_test_fills[fill], windows[i].operation, windows[i].args, fill_value, space, data, reference, ESDM_TEST_N, 1e-9);
+		}
+	}
+
+	// A NaN element is skipped in case of no fill value, without spoiling the following windows, also of the next fragments
+	if (esdm_dataspace_create_full(1, &size, &offset, SMD_DTYPE_DOUBLE, &vector))
+		return failed + 1;
+	memcpy(series, esdm_test_double[ESDM_TEST_FILL_NONE], sizeof(series));
+	series[10] = NAN;
+	for (i = 0; i < sizeof(windows) / sizeof(windows[0]) - 1; ++i) {
+		esdm_stream_data_t request;
+		memset(&request, 0, sizeof(esdm_stream_data_t));
+		request.operation = (char *) windows[i].operation;
+		request.args = "7";
+		esdm_test_rolling_reference(windows[i].reduction, series, &esdm_test_double_fill[ESDM_TEST_FILL_NAN], 7, 0, size, 1, reference);
+		failed += esdm_test_check("NaN and no fill value", &request, vector, series, 8, reference, size, 1e-9);
+	}
+	esdm_dataspace_destroy(vector);
+
+	return failed;
+}
+
+// Chains of element-wise operations and expressions, with the result written into the output buffer (by a single fragment),
+// overwriting the fragments in place, or reduced by the fused kernels
+static int esdm_test_chain(esdm_dataspace_t * space)
+{
+	static double reference[ESDM_TEST_N];
+	const double *data = esdm_test_double[ESDM_TEST_FILL_NONE];
+	esdm_test_acc_t acc;
+	esdm_stream_data_t request;
+	int in_place, failed = 0;
+	size_t j;
+
+	for (in_place = 0; in_place < 2; ++in_place) {
+		memset(&request, 0, sizeof(esdm_stream_data_t));
+		request.in_place = in_place;
+		int64_t rows = in_place ? ESDM_TEST_ROWS : ESDM_TEST_T;
+		const char *name = in_place ? "data in place" : "data";
+
+		for (j = 0; j < ESDM_TEST_N; ++j)
+			reference[j] = (data[j] - 300) * (data[j] - 300);
+		request.operation = "sum_scalar:-300|abs|sqr";
+		failed += esdm_test_check(name, &request, space, data, rows, reference, ESDM_TEST_N, 1e-12);
+
+		for (j = 0; j < ESDM_TEST_N; ++j)
+			reference[j] = (data[j] - 273.15) * 1.8 + 32;
+		request.operation = ESDM_FUNCTION_EXPR;
+		request.args = "(x-273.15)*1.8+32";
+		failed += esdm_test_check(name, &request, space, data, rows, reference, ESDM_TEST_N, 1e-12);
+
+		for (j = 0; j < ESDM_TEST_N; ++j)
+			reference[j] = sqrt(data[j] * data[j] + 1) * 3.6;
+		request.args = "sqrt(x*x+1)*3.6";
+		failed += esdm_test_check(name, &request, space, data, rows, reference, ESDM_TEST_N, 1e-12);
+
+		for (j = 0; j < ESDM_TEST_N; ++j)
+			reference[j] = log10(data[j]);
+		request.operation = ESDM_FUNCTION_LOG10;
+		request.args = NULL;
+		failed += esdm_test_check(name, &request, space, data, rows, reference, ESDM_TEST_N, 1e-12);
+
+		request.operation = ESDM_FUNCTION_NOP;
+		failed += esdm_test_check(name, &request, space, data, rows, data, ESDM_TEST_N, 0);
+	}
+
+	memset(&acc, 0, sizeof(esdm_test_acc_t));
+	for (j = 0; j < ESDM_TEST_N; ++j)
+		esdm_test_add(&acc, fabs(data[j] - 300));
+	reference[0] = acc.max;
+	failed += esdm_test_run("data", "sum_scalar:-300|abs|max", NULL, NULL, space, data, reference, 1, 0);
+	reference[0] = acc.sum;
+	failed += esdm_test_run("data", "expr:abs(x-300)|sum", NULL, NULL, space, data, reference, 1, 1e-9);
+
+	memset(&acc, 0, sizeof(esdm_test_acc_t));
+	for (j = 0; j < ESDM_TEST_N; ++j)
+		esdm_test_add(&acc, log10(data[j]));
+	reference[0] = esdm_test_result(ESDM_FUNCTION_AVG, &acc);
+	failed += esdm_test_run("data", "log10|avg", NULL, NULL, space, data, reference, 1, 1e-9);
+	reference[0] = esdm_test_result(ESDM_FUNCTION_STD, &acc);
+	failed += esdm_test_run("data", "log10|std", NULL, NULL, space, data, reference, 1, 1e-6);
+
+	return failed;
+}
+
+// Dimensions beyond the dataspace are reported by esdm_stream_prepare in case space is set, by esdm_stream_func otherwise
+static int esdm_test_errors(esdm_dataspace_t * space)
+{
+	static const struct {
+		const char *args;
+		int space;
+		esdm_status prepare;
+		int stream;
+	} cases[] = {
+		{"70", 0, ESDM_ERROR, 0},
+		{"0,64", 0, ESDM_ERROR, 0},
+		{"5", 1, ESDM_ERROR, 0},
+		{"2%12", 1, ESDM_ERROR, 0},
+		{"5", 0, ESDM_SUCCESS, 0},
+		{"1", 1, ESDM_SUCCESS, 1},
+		{"1%12", 0, ESDM_SUCCESS, 1},
+	};
+	int64_t size[2] = { 1, ESDM_TEST_X }, offset[2] = { ESDM_TEST_OFFSET_T, ESDM_TEST_OFFSET_X };
+	esdm_dataspace_t *fragment;
+	int failed = 0;
+	size_t i;
+
+	if (esdm_dataspace_subspace(space, 2, size, offset, &fragment))
+		return 1;
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		esdm_stream_data_t stream_data;
+		double out[ESDM_TEST_T * ESDM_TEST_X];
+		memset(&stream_data, 0, sizeof(esdm_stream_data_t));
+		stream_data.operation = ESDM_FUNCTION_AVG;
+		stream_data.args = (char *) cases[i].args;
+		stream_data.buff = out;
+		stream_data.space = cases[i].space ? space : NULL;
+		esdm_status status = esdm_stream_prepare(&stream_data);
+		void *tmp = status ? NULL : esdm_stream_func(fragment, esdm_test_double[ESDM_TEST_FILL_NONE], &stream_data, NULL);
+		if ((status != cases[i].prepare) || (!tmp != !cases[i].stream)) {
+			printf("%s: %s(%s) with space %s is %s by esdm_stream_prepare and %s by esdm_stream_func\n", esdm_test_isa, stream_data.operation,
+			       cases[i].args, cases[i].space ? "set" : "not set", status ? "refused" : "accepted", tmp ? "processed" : "refused");
+			failed++;
+		}
+		if (tmp)
+			esdm_reduce_func(fragment, &stream_data, tmp);
+		esdm_stream_release(&stream_data);
+	}
+	esdm_dataspace_destroy(fragment);
+
+	return failed;
+}
+
+static int esdm_test_supported(const char *isa)
+{
+	if (!strcmp(isa, "sse42"))
+		return ESDM_CPU_SUPPORTS("sse4.2");
+	if (!strcmp(isa, "avx2"))
+		return ESDM_CPU_SUPPORTS("avx2") && ESDM_CPU_SUPPORTS("fma");
+	if (!strcmp(isa, "avx512"))
+		return ESDM_CPU_SUPPORTS("avx512f") && ESDM_CPU_SUPPORTS("avx512bw");
+	return 1;
+}
+
+static int esdm_test_variant(esdm_dataspace_t * space, esdm_dataspace_t * space16)
+{
+	int failed = 0;
+
+	failed += esdm_test_stat(space);
+	failed += esdm_test_integer(space16);
+	failed += esdm_test_axis(space);
+	failed += esdm_test_histogram(space);
+	failed += esdm_test_quantile(space);
+	failed += esdm_test_arg(space);
+	failed += esdm_test_distinct(space);
+	failed += esdm_test_weighted(space);
+	failed += esdm_test_rolling(space);
+	failed += esdm_test_chain(space);
+	failed += esdm_test_errors(space);
+
+	return failed;
+}
+
+int main(void)
+{
+	static const struct {
+		const char *isa;
+		const esdm_kernel_row_t *kernels;
+	} variants[] = {
+		{"scalar", NULL},
+		{"generic", esdm_simd_kernels_generic},
+#ifdef HAVE_SIMD_SSE42
+		{"sse42", esdm_simd_kernels_sse42},
+#endif
+#ifdef HAVE_SIMD_AVX2
+		{"avx2", esdm_simd_kernels_avx2},
+#endif
+#ifdef HAVE_SIMD_AVX512
+		{"avx512", esdm_simd_kernels_avx512},
+#endif
+	};
+	int64_t size[2] = { ESDM_TEST_T, ESDM_TEST_X }, offset[2] = { ESDM_TEST_OFFSET_T, ESDM_TEST_OFFSET_X };
+	esdm_dataspace_t *space, *space16;
+	int fill, parallel, failed = 0;
+	size_t i, j;
+
+	if (esdm_dataspace_create_full(2, size, offset, SMD_DTYPE_DOUBLE, &space) || esdm_dataspace_create_full(2, size, offset, SMD_DTYPE_INT16, &space16))
+		return 1;
+
+	esdm_test_double_fill[ESDM_TEST_FILL_VALUE] = ESDM_TEST_FILL;
+	esdm_test_double_fill[ESDM_TEST_FILL_NAN] = NAN;
+	for (j = 0; j < ESDM_TEST_N; ++j) {
+		esdm_test_double[ESDM_TEST_FILL_NONE][j] = 250 + (double) (esdm_test_random() % 10000) / 100;
+		esdm_test_int16[ESDM_TEST_FILL_NONE][j] = (int16_t) (esdm_test_random() % (2 * ESDM_TEST_RANGE + 1)) - ESDM_TEST_RANGE;
+	}
+	esdm_test_double[ESDM_TEST_FILL_NONE][7 * ESDM_TEST_X + 3] = esdm_test_double[ESDM_TEST_FILL_NONE][150 * ESDM_TEST_X + 20] = 400;
+	esdm_test_double[ESDM_TEST_FILL_NONE][90 * ESDM_TEST_X + 41] = esdm_test_double[ESDM_TEST_FILL_NONE][201 * ESDM_TEST_X + 5] = 200;
+	for (fill = 1; fill < ESDM_TEST_FILL_N; ++fill)
+		for (j = 0; j < ESDM_TEST_N; ++j) {
+			esdm_test_double[fill][j] = j % ESDM_TEST_GAP ? esdm_test_double[ESDM_TEST_FILL_NONE][j] : esdm_test_double_fill[fill];
+			esdm_test_int16[fill][j] = j % ESDM_TEST_GAP ? esdm_test_int16[ESDM_TEST_FILL_NONE][j] : esdm_test_int16_fill;
+		}
+
+	for (i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i) {
+		if (!esdm_test_supported(variants[i].isa))
+			continue;
+		esdm_simd_kernels = variants[i].kernels;
+		esdm_test_isa = variants[i].isa;
+		for (parallel = 0; parallel < 2; ++parallel) {
+			int last = failed;
+			esdm_parallel_bytes = parallel ? ESDM_TEST_PARALLEL_BYTES : 0;
+			failed += esdm_test_variant(space, space16);
+			printf("%s%s: %d failed\n", esdm_test_isa, parallel ? " with parallel fragments" : "", failed - last);
+		}
+	}
+
+	esdm_dataspace_destroy(space);
+	esdm_dataspace_destroy(space16);
+
+	return failed ? 1 : 0;
+}